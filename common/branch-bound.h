@@ -0,0 +1,223 @@
+#ifndef BRANCH_BOUND_H
+#define BRANCH_BOUND_H
+
+#include <vector>
+#include <limits>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+#include <omp.h>
+
+#include "work-stealing.h"
+#include "incumbent.h"
+#include "preprocess.h"
+#include "stop-token.h"
+
+/*
+Depth-first branch and bound over paths that start at city 0 (at most 32
+cities, the visited set is a bitmask). Children are explored nearest city
+first; ParallelBnB splits the top of the tree into work-stealing tasks.
+*/
+
+
+// Lower bound for completing a path that ends at "last" having visited "mask":
+// "last" still needs an edge into an unvisited city and every unvisited city
+// needs an edge to another unvisited city or back to city 0.
+inline double lower_bound(std::vector<double> &d, int N, int last, uint32_t mask, double cost) {
+    uint32_t full = (N == 32) ? 0xffffffffu : ((1u << N) - 1);
+    if (mask == full) {
+        return cost + d[last * N];
+    }
+    double out_last = std::numeric_limits<double>::infinity();
+    double bound = cost;
+    for (int v=0; v<N; v++) {
+        if (mask & (1u << v)) {
+            continue;
+        }
+        out_last = std::min(out_last, d[last * N + v]);
+        double out_v = d[v * N];
+        for (int u=1; u<N; u++) {
+            if (u != v && !(mask & (1u << u))) {
+                out_v = std::min(out_v, d[v * N + u]);
+            }
+        }
+        bound += out_v;
+    }
+    return bound + out_last;
+}
+
+// Read-only data shared by every search thread
+struct BnBData {
+    int N;
+    std::vector<double> d;
+    // nbr[c * N + k] is the k-th nearest city to c (c itself comes first)
+    std::vector<int> nbr;
+    // Sort children by lower bound instead of by edge length
+    bool bound_order;
+    // Hull order and allowed edges, null without "--prep"
+    const Preprocess *prep;
+    // Abandons the search when raised, null when it always runs to the end
+    StopToken *stop;
+};
+
+inline BnBData make_data(std::vector<double> d, int N, bool bound_order, bool index_order) {
+    BnBData data{N, std::move(d), {}, bound_order, nullptr, nullptr};
+    data.nbr.resize(N * N);
+    for (int c=0; c<N; c++) {
+        int *row = &data.nbr[c * N];
+        for (int i=0; i<N; i++) {
+            row[i] = i;
+        }
+        if (!index_order) {
+            std::sort(row, row + N, [&](int a, int b) {
+                return data.d[c * N + a] < data.d[c * N + b];
+            });
+        }
+    }
+    return data;
+}
+
+// Moves the neighbours of every city on a known good tour to the front of
+// its child order, so the first dive retraces that tour.
+inline void hint_order(BnBData &data, const std::vector<int> &tour) {
+    int N = data.N;
+    for (int k=0; k<N; k++) {
+        int c = tour[k];
+        int hints[2] = {tour[(k + 1) % N], tour[(k + N - 1) % N]};
+        int *row = &data.nbr[c * N];
+        for (int h=1; h>=0; h--) {
+            int *at = std::find(row, row + N, hints[h]);
+            std::rotate(row, at, at + 1);
+        }
+    }
+}
+
+// Children generated and cut by the bound at each depth, one per thread
+struct alignas(64) DepthStats {
+    std::vector<long> children;
+    std::vector<long> pruned;
+};
+
+struct Child {
+    int city;
+    double cost;
+    double bound;
+    HullState hull;
+};
+
+// Children of a node in exploration order: nearest unvisited city first, or
+// smallest lower bound first with "bound_order". Children whose bound cannot
+// beat the incumbent are dropped, and with "--prep" so are eliminated edges
+// and cities that break the hull order. Returns the number of children kept.
+inline int order_children(BnBData &data, int depth, int last, uint32_t mask, double cost, HullState hull, Incumbent &best, Child *out, DepthStats &stats) {
+    int N = data.N;
+    const Preprocess *prep = data.prep;
+    int n = 0;
+    for (int k=0; k<N; k++) {
+        int i = data.nbr[last * N + k];
+        if (mask & (1u << i)) {
+            continue;
+        }
+        HullState child_hull = hull;
+        if (prep && (!prep->edge(last, i) || (depth + 1 == N && !prep->edge(i, 0)) || !prep->hull_step(child_hull, i))) {
+            continue;
+        }
+        stats.children[depth]++;
+        double c = cost + data.d[last * N + i];
+        double bound = lower_bound(data.d, N, i, mask | (1u << i), c);
+        if (bound >= best.cutoff()) {
+            stats.pruned[depth]++;
+            continue;
+        }
+        out[n++] = {i, c, bound, child_hull};
+    }
+    if (data.bound_order) {
+        std::stable_sort(out, out + n, [](const Child &a, const Child &b) {
+            return a.bound < b.bound;
+        });
+    }
+    return n;
+}
+
+inline void branch_n_bound(BnBData &data, int idx, uint32_t mask, double curr_cost, HullState hull, Incumbent &best, std::vector<int> &curr_sol, DepthStats &stats) {
+    int N = data.N;
+    int last = curr_sol[idx-1];
+    if (data.stop && data.stop->stop_requested()) {
+        return;
+    }
+    if (idx == N) {
+        best.offer(curr_cost + data.d[last * N + curr_sol[0]], curr_sol);
+        return;
+    }
+    Child children[32];
+    int n = order_children(data, idx, last, mask, curr_cost, hull, best, children, stats);
+    for (int k=0; k<n; k++) {
+        // The incumbent may have improved since the children were generated
+        if (children[k].bound >= best.cutoff()) {
+            stats.pruned[idx]++;
+            continue;
+        }
+        int i = children[k].city;
+        curr_sol[idx] = i;
+        branch_n_bound(data, idx+1, mask | (1u << i), children[k].cost, children[k].hull, best, curr_sol, stats);
+        curr_sol[idx] = -1;
+    }
+    return;
+}
+
+// Open subtree handed to the work-stealing scheduler
+struct Prefix {
+    int idx;
+    uint32_t mask;
+    double cost;
+    double bound;
+    HullState hull;
+    std::vector<int> sol;
+};
+
+// Splits prefixes into child tasks until only "grain" cities are left to
+// place, then finishes the subtree sequentially.
+struct ParallelBnB {
+    BnBData &data;
+    int grain;
+    Incumbent &best;
+    std::vector<DepthStats> &stats;
+
+    void operator()(Prefix *p, WorkStealing<Prefix> &sched) {
+        DepthStats &st = stats[omp_get_thread_num()];
+        if (data.stop && data.stop->stop_requested()) {
+            return;
+        }
+        if (p->bound >= best.cutoff()) {
+            st.pruned[p->idx-1]++;
+            return;
+        }
+        if (data.N - p->idx <= grain) {
+            branch_n_bound(data, p->idx, p->mask, p->cost, p->hull, best, p->sol, st);
+            return;
+        }
+        Child children[32];
+        int n = order_children(data, p->idx, p->sol[p->idx-1], p->mask, p->cost, p->hull, best, children, st);
+        // Pushed in reverse so the owner pops the first child first
+        for (int k=n-1; k>=0; k--) {
+            int i = children[k].city;
+            Prefix *child = new Prefix{p->idx + 1, p->mask | (1u << i), children[k].cost, children[k].bound, children[k].hull, p->sol};
+            child->sol[p->idx] = i;
+            sched.spawn(child, *this);
+        }
+    }
+};
+
+inline void report_depths(std::vector<DepthStats> &stats, int N) {
+    std::cerr << "depth children pruned ratio" << std::endl;
+    for (int depth=1; depth<N; depth++) {
+        long children = 0, pruned = 0;
+        for (auto &st : stats) {
+            children += st.children[depth];
+            pruned += st.pruned[depth];
+        }
+        std::cerr << depth << " " << children << " " << pruned << " " << (children ? double(pruned) / children : 0) << std::endl;
+    }
+}
+
+#endif
@@ -0,0 +1,198 @@
+#ifndef CHECKPOINT_H
+#define CHECKPOINT_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <cstdio>
+#include <cstdint>
+#include <chrono>
+#include <mutex>
+#include <atomic>
+#include <fcntl.h>
+#include <unistd.h>
+
+/*
+Restart files for long exact runs. A checkpoint holds the incumbent, the
+unfinished part of the search (rank ranges of the tour space and/or open
+path prefixes), written as raw little-endian fields, plus the search that
+wrote it and a fingerprint of the distance matrix, so a run never resumes
+another search or another instance of the same size. Files are written to "<path>.tmp", synced to disk
+and renamed over "<path>", so a crash while saving leaves the previous
+checkpoint intact.
+*/
+
+#define CHECKPOINT_MAGIC 0x43505354u
+#define CHECKPOINT_VERSION 3u
+
+// Searches that write checkpoints, each one only resumes its own
+#define CHECKPOINT_BB 1u
+#define CHECKPOINT_ENUM 2u
+#define CHECKPOINT_ENUM_BNB 3u
+
+
+// FNV-1a over N and the bytes of the N x N distance matrix
+inline uint64_t instance_fingerprint(const double *d, int N) {
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto mix = [&](const void *data, size_t bytes) {
+        const unsigned char *b = static_cast<const unsigned char *>(data);
+        for (size_t i=0; i<bytes; i++) {
+            h = (h ^ b[i]) * 0x100000001b3ull;
+        }
+    };
+    mix(&N, sizeof(N));
+    mix(d, size_t(N) * N * sizeof(double));
+    return h;
+}
+
+
+struct Checkpoint {
+    int32_t N = 0;
+    // One of the CHECKPOINT_* searches above
+    uint32_t engine = 0;
+    // instance_fingerprint() of the distance matrix
+    uint64_t instance = 0;
+    double best_cost = 0;
+    std::vector<int32_t> best_tour;
+    // Unfinished rank ranges [first, second)
+    std::vector<std::pair<uint64_t, uint64_t>> ranges;
+    // Unfinished subtrees, each given by its path from city 0
+    std::vector<std::vector<int32_t>> prefixes;
+};
+
+template <typename T>
+void checkpoint_put(std::ofstream &out, const T &v) {
+    out.write(reinterpret_cast<const char *>(&v), sizeof(T));
+}
+
+template <typename T>
+bool checkpoint_get(std::ifstream &in, T &v) {
+    return bool(in.read(reinterpret_cast<char *>(&v), sizeof(T)));
+}
+
+inline bool save_checkpoint(const std::string &path, const Checkpoint &cp) {
+    std::string tmp = path + ".tmp";
+    {
+        std::ofstream out(tmp, std::ios::binary | std::ios::trunc);
+        checkpoint_put(out, CHECKPOINT_MAGIC);
+        checkpoint_put(out, CHECKPOINT_VERSION);
+        checkpoint_put(out, cp.N);
+        checkpoint_put(out, cp.engine);
+        checkpoint_put(out, cp.instance);
+        checkpoint_put(out, cp.best_cost);
+        checkpoint_put(out, uint32_t(cp.best_tour.size()));
+        out.write(reinterpret_cast<const char *>(cp.best_tour.data()), cp.best_tour.size() * sizeof(int32_t));
+        checkpoint_put(out, uint64_t(cp.ranges.size()));
+        for (auto &r : cp.ranges) {
+            checkpoint_put(out, r.first);
+            checkpoint_put(out, r.second);
+        }
+        checkpoint_put(out, uint64_t(cp.prefixes.size()));
+        for (auto &p : cp.prefixes) {
+            checkpoint_put(out, uint32_t(p.size()));
+            out.write(reinterpret_cast<const char *>(p.data()), p.size() * sizeof(int32_t));
+        }
+        if (!out.flush()) {
+            return false;
+        }
+    }
+    // The data has to be on disk before the rename can replace the old file
+    int fd = open(tmp.c_str(), O_WRONLY);
+    if (fd < 0) {
+        return false;
+    }
+    bool synced = fsync(fd) == 0;
+    close(fd);
+    if (!synced) {
+        return false;
+    }
+    return std::rename(tmp.c_str(), path.c_str()) == 0;
+}
+
+// False when the file is missing, truncated or from another format version.
+// Lengths are checked against the bytes left before anything is allocated.
+inline bool load_checkpoint(const std::string &path, Checkpoint &cp) {
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    uint64_t size = in ? uint64_t(in.tellg()) : 0;
+    in.seekg(0);
+    auto fits = [&](uint64_t count, uint64_t bytes) {
+        std::streamoff at = in.tellg();
+        return at >= 0 && count <= (size - uint64_t(at)) / bytes;
+    };
+    uint32_t magic, version, len;
+    uint64_t count;
+    if (!checkpoint_get(in, magic) || !checkpoint_get(in, version) || magic != CHECKPOINT_MAGIC || version != CHECKPOINT_VERSION) {
+        return false;
+    }
+    if (!checkpoint_get(in, cp.N) || !checkpoint_get(in, cp.engine) || !checkpoint_get(in, cp.instance) || !checkpoint_get(in, cp.best_cost) || !checkpoint_get(in, len) || !fits(len, sizeof(int32_t))) {
+        return false;
+    }
+    cp.best_tour.resize(len);
+    in.read(reinterpret_cast<char *>(cp.best_tour.data()), len * sizeof(int32_t));
+    if (!checkpoint_get(in, count) || !fits(count, 2 * sizeof(uint64_t))) {
+        return false;
+    }
+    cp.ranges.resize(count);
+    for (auto &r : cp.ranges) {
+        if (!checkpoint_get(in, r.first) || !checkpoint_get(in, r.second)) {
+            return false;
+        }
+    }
+    if (!checkpoint_get(in, count) || !fits(count, sizeof(uint32_t))) {
+        return false;
+    }
+    cp.prefixes.resize(count);
+    for (auto &p : cp.prefixes) {
+        if (!checkpoint_get(in, len) || !fits(len, sizeof(int32_t))) {
+            return false;
+        }
+        p.resize(len);
+        in.read(reinterpret_cast<char *>(p.data()), len * sizeof(int32_t));
+    }
+    return bool(in);
+}
+
+// Decides when the next checkpoint is due and accounts for the time spent
+// writing them. One thread at a time gets to save.
+class CheckpointTimer {
+public:
+    CheckpointTimer(double interval) : interval(interval), saves(0), spent(0), last(now()) {}
+
+    // True for at most one caller once "interval" seconds have passed; that
+    // caller must call saved() when done.
+    bool due() {
+        if (now() - last.load(std::memory_order_relaxed) < interval || !mutex.try_lock()) {
+            return false;
+        }
+        begin = now();
+        if (begin - last.load(std::memory_order_relaxed) < interval) {
+            mutex.unlock();
+            return false;
+        }
+        return true;
+    }
+
+    void saved() {
+        double end = now();
+        last.store(end, std::memory_order_relaxed);
+        spent += end - begin;
+        saves++;
+        mutex.unlock();
+    }
+
+    double interval;
+    long saves;
+    // Seconds spent writing checkpoints
+    double spent;
+
+private:
+    static double now() {
+        return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+    }
+
+    std::atomic<double> last;
+    double begin;
+    std::mutex mutex;
+};
+
+#endif
@@ -0,0 +1,223 @@
+#ifndef DISTRIBUTED_STEAL_H
+#define DISTRIBUTED_STEAL_H
+
+#include <vector>
+#include <deque>
+#include <random>
+#include <algorithm>
+#include <mpi.h>
+
+/*
+Decentralized load balancing of open search nodes over MPI ranks. A rank
+that runs out of work asks a random victim, which answers with the older
+half of its deque (the shallowest nodes, so the largest subtrees) or with
+nothing. Termination is detected with Safra's token ring: every rank counts
+work messages sent minus received and turns black when work arrives; rank 0
+declares the end once a token comes back white with a zero total while all
+ranks are idle. No rank hands out work centrally.
+*/
+
+#define STEAL_REQUEST 48
+#define STEAL_REPLY 49
+#define STEAL_TOKEN 50
+#define STEAL_DONE 51
+
+
+// Path from city 0 and its cost
+struct StealNode {
+    double cost;
+    std::vector<int> path;
+};
+
+class DistributedSteal {
+public:
+    DistributedSteal(MPI_Comm comm, unsigned seed) : attempts(0), successes(0), moved(0), latency(0), max_latency(0), waves(0), idle_since(0), done_at(0),
+            comm(comm), rng(seed), waiting(false), done(false), count(0), black(false), has_token(false), token_out(false) {
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+        token[0] = token[1] = 0;
+    }
+
+    // Local open nodes, the back is explored next
+    std::deque<StealNode> work;
+
+    // Answers steal requests and, when "idle", passes on the termination
+    // token. Cheap enough to call every few thousand nodes.
+    void serve(bool idle) {
+        int flag;
+        MPI_Status status;
+        for (MPI_Iprobe(MPI_ANY_SOURCE, STEAL_REQUEST, comm, &flag, &status); flag; MPI_Iprobe(MPI_ANY_SOURCE, STEAL_REQUEST, comm, &flag, &status)) {
+            MPI_Recv(nullptr, 0, MPI_INT, status.MPI_SOURCE, STEAL_REQUEST, comm, MPI_STATUS_IGNORE);
+            give(status.MPI_SOURCE);
+        }
+        MPI_Iprobe(MPI_ANY_SOURCE, STEAL_TOKEN, comm, &flag, &status);
+        if (flag) {
+            MPI_Recv(token, 2, MPI_LONG, status.MPI_SOURCE, STEAL_TOKEN, comm, MPI_STATUS_IGNORE);
+            has_token = true;
+        }
+        MPI_Iprobe(0, STEAL_DONE, comm, &flag, MPI_STATUS_IGNORE);
+        if (flag) {
+            MPI_Recv(nullptr, 0, MPI_INT, 0, STEAL_DONE, comm, MPI_STATUS_IGNORE);
+            finished();
+        }
+        if (idle && !done) {
+            pass_token();
+        }
+    }
+
+    // Called with an empty deque: steals until work arrives (true) or every
+    // rank is out of work (false). "between()" runs on every poll.
+    template <typename Between>
+    bool refill(Between between) {
+        idle_since = MPI_Wtime();
+        if (size == 1) {
+            finished();
+            return false;
+        }
+        while (true) {
+            between();
+            serve(true);
+            if (done) {
+                return false;
+            }
+            if (!waiting) {
+                int victim = std::uniform_int_distribution<int>(0, size - 2)(rng);
+                victim += (victim >= rank);
+                MPI_Send(nullptr, 0, MPI_INT, victim, STEAL_REQUEST, comm);
+                waiting = true;
+                asked_at = MPI_Wtime();
+                attempts++;
+            }
+            if (receive_reply()) {
+                return true;
+            }
+        }
+    }
+
+    // Collective, after refill() returned false. Every rank keeps answering
+    // (with nothing) until all outstanding requests are answered.
+    template <typename Between>
+    void finish(Between between) {
+        while (waiting) {
+            between();
+            serve(true);
+            receive_reply();
+        }
+        MPI_Request barrier;
+        MPI_Ibarrier(comm, &barrier);
+        for (int all = 0; !all; ) {
+            between();
+            serve(true);
+            MPI_Test(&barrier, &all, MPI_STATUS_IGNORE);
+        }
+    }
+
+    // Steal requests sent and answered with work, nodes received
+    long attempts, successes, moved;
+    // Seconds from request to reply, summed and worst
+    double latency, max_latency;
+    // Token rounds started (rank 0 only)
+    long waves;
+    // MPI_Wtime when the rank last ran dry and when it learned the search ended
+    double idle_since, done_at;
+
+private:
+    // Sends the older half of the deque, or nothing, to "thief"
+    void give(int thief) {
+        int n = done ? 0 : (work.size() + 1) / 2;
+        std::vector<double> data(1, n);
+        for (int k=0; k<n; k++) {
+            StealNode &node = work.front();
+            data.push_back(node.cost);
+            data.push_back(node.path.size());
+            data.insert(data.end(), node.path.begin(), node.path.end());
+            work.pop_front();
+        }
+        MPI_Send(data.data(), data.size(), MPI_DOUBLE, thief, STEAL_REPLY, comm);
+        count += (n > 0);
+    }
+
+    // Takes the answer to the outstanding request if it arrived, true if it
+    // brought work
+    bool receive_reply() {
+        int flag, len;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, STEAL_REPLY, comm, &flag, &status);
+        if (!flag) {
+            return false;
+        }
+        MPI_Get_count(&status, MPI_DOUBLE, &len);
+        std::vector<double> data(len);
+        MPI_Recv(data.data(), len, MPI_DOUBLE, status.MPI_SOURCE, STEAL_REPLY, comm, MPI_STATUS_IGNORE);
+        waiting = false;
+        double wait = MPI_Wtime() - asked_at;
+        latency += wait;
+        max_latency = std::max(max_latency, wait);
+        int n = data[0];
+        size_t at = 1;
+        for (int k=0; k<n; k++) {
+            StealNode node{data[at], std::vector<int>(int(data[at+1]))};
+            for (size_t i=0; i<node.path.size(); i++) {
+                node.path[i] = int(data[at+2+i]);
+            }
+            at += 2 + node.path.size();
+            work.push_back(std::move(node));
+        }
+        if (n > 0) {
+            successes++;
+            moved += n;
+            count--;
+            black = true;
+        }
+        return n > 0;
+    }
+
+    // Safra: rank 0 starts a round when idle and judges the returning token,
+    // the others add their count and colour and forward it
+    void pass_token() {
+        if (rank == 0) {
+            if (has_token) {
+                has_token = false;
+                token_out = false;
+                if (token[1] == 0 && !black && token[0] + count == 0) {
+                    for (int r=1; r<size; r++) {
+                        MPI_Send(nullptr, 0, MPI_INT, r, STEAL_DONE, comm);
+                    }
+                    finished();
+                    return;
+                }
+            }
+            if (!token_out) {
+                long fresh[2] = {0, 0};
+                black = false;
+                MPI_Send(fresh, 2, MPI_LONG, 1, STEAL_TOKEN, comm);
+                token_out = true;
+                waves++;
+            }
+        }
+        else if (has_token) {
+            token[0] += count;
+            token[1] |= black;
+            black = false;
+            MPI_Send(token, 2, MPI_LONG, (rank + 1) % size, STEAL_TOKEN, comm);
+            has_token = false;
+        }
+    }
+
+    void finished() {
+        done = true;
+        done_at = MPI_Wtime();
+    }
+
+    MPI_Comm comm;
+    int rank, size;
+    std::mt19937 rng;
+    bool waiting, done;
+    double asked_at;
+    // Safra state: work messages sent minus received, colour, token
+    long count;
+    bool black, has_token, token_out;
+    long token[2];
+};
+
+#endif
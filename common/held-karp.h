@@ -0,0 +1,227 @@
+#ifndef HELD_KARP_H
+#define HELD_KARP_H
+
+#include <vector>
+#include <algorithm>
+#include <string>
+#include <limits>
+#include <iostream>
+#include <cstdint>
+#include <omp.h>
+// Table storage
+#include <sys/mman.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include "subset-rank.h"
+#include "stop-token.h"
+
+/*
+Held-Karp dynamic programming over the cities 1..N-1 (city 0 is the start).
+Layer k holds every subset S of size k in rank order and, for each city e
+of S, the cheapest path 0 -> ... -> e through exactly S, so a layer is a
+dense array of C(N-1, k) * k costs and layers are filled in parallel.
+Layers backed by files are filled in chunks of HELD_KARP_CHUNK subsets
+whose pages are dropped from the resident set once written, and a layer is
+dropped whole once the next one is done, so only about the layer being
+read stays in RAM. The pages come back from the file when they are read.
+*/
+
+#define HELD_KARP_CHUNK (1 << 20)
+
+
+// One DP layer, anonymous memory or a file mapping under "dir"
+template <typename T>
+struct DPLayer {
+    DPLayer(size_t n, const std::string &dir) : size(n), data(nullptr), file(!dir.empty()) {
+        size_t bytes = std::max<size_t>(n, 1) * sizeof(T);
+        if (dir.empty()) {
+            void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            data = (p == MAP_FAILED) ? nullptr : (T *)p;
+            return;
+        }
+        std::string path = dir + "/hk-layer-XXXXXX";
+        int fd = mkstemp(&path[0]);
+        if (fd < 0) {
+            return;
+        }
+        // The file only lives as long as the mapping
+        unlink(path.c_str());
+        if (ftruncate(fd, bytes) == 0) {
+            void *p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+            data = (p == MAP_FAILED) ? nullptr : (T *)p;
+        }
+        close(fd);
+    }
+
+    ~DPLayer() {
+        if (data != nullptr) {
+            munmap(data, std::max<size_t>(size, 1) * sizeof(T));
+        }
+    }
+
+    DPLayer(const DPLayer &) = delete;
+    DPLayer &operator=(const DPLayer &) = delete;
+
+    // Drops the whole pages of entries [from, to) from the resident set if
+    // the layer is a file mapping. Anonymous memory has nowhere else to keep them.
+    void release(size_t from, size_t to) {
+        if (!file || data == nullptr || from >= to) {
+            return;
+        }
+        uintptr_t page = sysconf(_SC_PAGE_SIZE);
+        uintptr_t lo = ((uintptr_t)(data + from) + page - 1) / page * page;
+        uintptr_t hi = (uintptr_t)(data + to) / page * page;
+        if (lo < hi) {
+            madvise((void *)lo, hi - lo, MADV_DONTNEED);
+        }
+    }
+
+    size_t size;
+    T *data;
+    bool file;
+};
+
+// Bytes needed by the full table
+inline size_t held_karp_bytes(int N, size_t cost_size) {
+    int n = N - 1;
+    return n > 0 ? cost_size * n * (size_t(1) << (n - 1)) : 0;
+}
+
+// Fills layers 1..max_layer. Entry (S, e) lives at rank(S) * k + position of e in S.
+template <typename T>
+bool held_karp_layers(std::vector<double> &d, int N, int max_layer, SubsetRank &sr, std::vector<DPLayer<T> *> &layers, const std::string &dir, StopToken *stop = nullptr) {
+    int n = N - 1;
+    layers.assign(max_layer + 1, nullptr);
+    for (int k=1; k<=max_layer; k++) {
+        if (stop && stop->stop_requested()) {
+            return false;
+        }
+        uint64_t count = sr.choose(n, k);
+        layers[k] = new DPLayer<T>(count * k, dir);
+        if (layers[k]->data == nullptr) {
+            std::cerr << "Could not allocate DP layer " << k << std::endl;
+            return false;
+        }
+        T *curr = layers[k]->data;
+        if (k == 1) {
+            for (int e=0; e<n; e++) {
+                curr[e] = d[e + 1];
+            }
+            continue;
+        }
+        T *prev = layers[k-1]->data;
+        #pragma omp parallel
+        {
+            int pos[32];
+            uint64_t part[32];
+            for (uint64_t first=0; first<count; first+=HELD_KARP_CHUNK) {
+                uint64_t last = std::min<uint64_t>(count, first + HELD_KARP_CHUNK);
+                #pragma omp for schedule(dynamic, 1024)
+                for (uint64_t r=first; r<last; r++) {
+                    // Cancelled layers are discarded, the remaining iterations just drain
+                    if (stop && stop->stop_requested()) {
+                        continue;
+                    }
+                    uint32_t S = sr.unrank(r, k);
+                    int t = 0;
+                    for (uint32_t m=S; m; m &= m - 1) {
+                        pos[t++] = __builtin_ctz(m);
+                    }
+                    // rank(S \ {pos[i]}) = sum over t<i of C(pos[t], t+1) + sum over t>i of C(pos[t], t)
+                    uint64_t suffix = 0;
+                    for (int i=k-1; i>=0; i--) {
+                        part[i] = suffix;
+                        suffix += sr.choose(pos[i], i);
+                    }
+                    uint64_t prefix = 0;
+                    for (int i=0; i<k; i++) {
+                        uint64_t sub = prefix + part[i];
+                        prefix += sr.choose(pos[i], i + 1);
+                        int e = pos[i] + 1;
+                        T best = std::numeric_limits<T>::max();
+                        const T *row = prev + sub * (k - 1);
+                        for (int j=0; j<k-1; j++) {
+                            int city = pos[j + (j >= i)] + 1;
+                            T c = row[j] + (T)d[city * N + e];
+                            if (c < best) {
+                                best = c;
+                            }
+                        }
+                        curr[r * k + i] = best;
+                    }
+                }
+                #pragma omp single
+                {
+                    layers[k]->release(first * k, last * k);
+                }
+            }
+        }
+        layers[k-1]->release(0, layers[k-1]->size);
+    }
+    return !(stop && stop->stop_requested());
+}
+
+// Walks the table back from city "e" with subset "S" (of size k), writing the
+// path 0 -> ... -> e into tour[1..k]
+template <typename T>
+void held_karp_path(std::vector<double> &d, int N, SubsetRank &sr, std::vector<DPLayer<T> *> &layers, uint32_t S, int e, std::vector<int> &tour) {
+    for (int k=__builtin_popcount(S); k>=1; k--) {
+        tour[k] = e;
+        S &= ~(1u << (e - 1));
+        if (k == 1) {
+            break;
+        }
+        const T *row = layers[k-1]->data + sr.rank(S) * (k - 1);
+        T best = std::numeric_limits<T>::max();
+        int arg = -1, j = 0;
+        for (uint32_t m=S; m; m &= m - 1, j++) {
+            int city = __builtin_ctz(m) + 1;
+            T c = row[j] + (T)d[city * N + e];
+            if (c < best) {
+                best = c;
+                arg = city;
+            }
+        }
+        e = arg;
+    }
+}
+
+// Optimal tour starting at city 0. Returns its DP cost or infinity when the
+// table could not be allocated or "stop" was raised.
+template <typename T>
+double held_karp(std::vector<double> &d, int N, std::vector<int> &tour, const std::string &dir = "", StopToken *stop = nullptr) {
+    tour.assign(N, 0);
+    if (N <= 1) {
+        return 0;
+    }
+    int n = N - 1;
+    SubsetRank sr(n);
+    std::vector<DPLayer<T> *> layers;
+    double result = std::numeric_limits<double>::infinity();
+    if (held_karp_layers<T>(d, N, n, sr, layers, dir, stop)) {
+        uint32_t full = (n == 32) ? 0xffffffffu : ((1u << n) - 1);
+        const T *last = layers[n]->data;
+        T best = std::numeric_limits<T>::max();
+        int arg = 1;
+        for (int i=0; i<n; i++) {
+            T c = last[i] + (T)d[(i + 1) * N];
+            if (c < best) {
+                best = c;
+                arg = i + 1;
+            }
+        }
+        held_karp_path<T>(d, N, sr, layers, full, arg, tour);
+        // Same direction as the enumeration solvers report
+        if (N > 2 && tour[1] > tour[N-1]) {
+            std::reverse(tour.begin() + 1, tour.end());
+        }
+        result = best;
+    }
+    for (auto layer : layers) {
+        delete layer;
+    }
+    return result;
+}
+
+#endif
@@ -0,0 +1,190 @@
+#ifndef INCUMBENT_H
+#define INCUMBENT_H
+
+#include <atomic>
+#include <vector>
+#include <limits>
+#include <cstdint>
+#include <functional>
+#include <algorithm>
+#include <mutex>
+
+/*
+Best tour shared by all search threads without locks.
+The cost is a single atomic updated by CAS, so pruning reads are one load.
+The winner of the CAS then copies its tour into one of two slots, each
+guarded by a sequence counter; "epoch" counts published tours so readers
+can tell when a new one is available. An optional listener is called
+after every improvement, e.g. to stream an anytime trace.
+In deterministic mode offers are serialized by a mutex instead: tours are
+made canonical, their cost is recomputed in one fixed order and ties go to
+the lexicographically smaller tour, so the result does not depend on which
+thread offered first. Searches prune against cutoff(), which then lies a
+relative 1e-9 above the cost so tied tours still reach offer().
+*/
+
+
+// Rotates "tour" to start at city 0 and orients it so tour[1] < tour[N-1],
+// the form the exact solvers enumerate
+inline void canonical_tour(std::vector<int> &tour) {
+    std::rotate(tour.begin(), std::find(tour.begin(), tour.end(), 0), tour.end());
+    if (tour.size() > 2 && tour[1] > tour.back()) {
+        std::reverse(tour.begin() + 1, tour.end());
+    }
+}
+
+class Incumbent {
+public:
+    Incumbent(int n) : best(std::numeric_limits<double>::infinity()), tickets(0), published(0), slots{Slot(n), Slot(n)} {}
+
+    // Current best cost, cheap enough to call on every node
+    double cost() const {
+        return best.load(std::memory_order_relaxed);
+    }
+
+    // Pruning threshold: subtrees and tours at or above it cannot win
+    double cutoff() const {
+        return cutoff(cost());
+    }
+
+    double cutoff(double c) const {
+        return length ? c * (1 + 1e-9) : c;
+    }
+
+    // Number of tours published so far
+    uint64_t epoch() const {
+        return published.load(std::memory_order_acquire);
+    }
+
+    // Returns true when "c" improved the incumbent and "tour" was published
+    bool offer(double c, const int *tour) {
+        if (length) {
+            return offer_ordered(c, tour);
+        }
+        double curr = best.load(std::memory_order_relaxed);
+        while (c < curr) {
+            if (best.compare_exchange_weak(curr, c, std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                publish(c, tour);
+                if (listener) {
+                    listener(c);
+                }
+                return true;
+            }
+        }
+        return false;
+    }
+
+    bool offer(double c, const std::vector<int> &tour) {
+        return offer(c, tour.data());
+    }
+
+    // Set before the search starts, it is not synchronized
+    void on_improve(std::function<void(double)> fn) {
+        listener = fn;
+    }
+
+    // Switches to deterministic mode, "fn" gives the cost of a canonical
+    // tour. Set before the search starts.
+    void deterministic(std::function<double(const int *)> fn) {
+        length = fn;
+    }
+
+    // Copy of the best published tour. Empty if nothing was published yet.
+    std::vector<int> tour() const {
+        if (length) {
+            std::lock_guard<std::mutex> guard(order_lock);
+            return ordered;
+        }
+        std::vector<int> out, tmp(slots[0].tour.size());
+        double out_cost = std::numeric_limits<double>::infinity();
+        for (int s=0; s<2; s++) {
+            const Slot &slot = slots[s];
+            for (;;) {
+                uint64_t seq = slot.seq.load(std::memory_order_acquire);
+                if (seq & 1) {
+                    continue;
+                }
+                double c = slot.cost.load(std::memory_order_relaxed);
+                for (size_t i=0; i<tmp.size(); i++) {
+                    tmp[i] = slot.tour[i].load(std::memory_order_relaxed);
+                }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (slot.seq.load(std::memory_order_relaxed) != seq) {
+                    continue;
+                }
+                if (c < out_cost) {
+                    out_cost = c;
+                    out = tmp;
+                }
+                break;
+            }
+        }
+        return out;
+    }
+
+private:
+    // Deterministic mode: compares (cost, canonical tour) under the lock
+    bool offer_ordered(double c, const int *tour) {
+        if (!(c < cutoff())) {
+            return false;
+        }
+        std::vector<int> t(tour, tour + slots[0].tour.size());
+        canonical_tour(t);
+        c = length(t.data());
+        std::lock_guard<std::mutex> guard(order_lock);
+        double curr = best.load(std::memory_order_relaxed);
+        if (c < curr || (c == curr && t < ordered)) {
+            best.store(c, std::memory_order_relaxed);
+            ordered = t;
+            published.fetch_add(1, std::memory_order_release);
+            if (listener) {
+                listener(c);
+            }
+            return true;
+        }
+        return false;
+    }
+
+    struct Slot {
+        Slot(int n) : seq(0), cost(std::numeric_limits<double>::infinity()), tour(n) {}
+        alignas(64) std::atomic<uint64_t> seq;
+        std::atomic<double> cost;
+        std::vector<std::atomic<int>> tour;
+    };
+
+    // Writers alternate between the slots by epoch. A slot only accepts a
+    // tour cheaper than the one it holds, so the global best can never be
+    // overwritten by a slower writer that won an earlier CAS.
+    void publish(double c, const int *tour) {
+        int s = tickets.fetch_add(1, std::memory_order_relaxed) & 1;
+        for (;;) {
+            Slot &slot = slots[s];
+            uint64_t seq = slot.seq.load(std::memory_order_relaxed);
+            if (!(seq & 1) && slot.seq.compare_exchange_strong(seq, seq + 1, std::memory_order_acquire, std::memory_order_relaxed)) {
+                std::atomic_thread_fence(std::memory_order_release);
+                if (c < slot.cost.load(std::memory_order_relaxed)) {
+                    slot.cost.store(c, std::memory_order_relaxed);
+                    for (size_t i=0; i<slot.tour.size(); i++) {
+                        slot.tour[i].store(tour[i], std::memory_order_relaxed);
+                    }
+                }
+                slot.seq.store(seq + 2, std::memory_order_release);
+                published.fetch_add(1, std::memory_order_release);
+                return;
+            }
+            // The other writer holds this slot, use the other one
+            s ^= 1;
+        }
+    }
+
+    alignas(64) std::atomic<double> best;
+    alignas(64) std::atomic<uint64_t> tickets;
+    std::atomic<uint64_t> published;
+    Slot slots[2];
+    std::function<void(double)> listener;
+    std::function<double(const int *)> length;
+    mutable std::mutex order_lock;
+    std::vector<int> ordered;
+};
+
+#endif
@@ -0,0 +1,194 @@
+#ifndef LOCAL_SEARCH_H
+#define LOCAL_SEARCH_H
+
+#include <vector>
+#include <algorithm>
+#include <random>
+#include <chrono>
+
+#include "incumbent.h"
+#include "stop-token.h"
+
+/*
+Heuristics on integer tours over a flat distance matrix: 2-opt and Or-opt
+descents and an iterated local search that kicks the tour with a random
+double bridge and keeps the result when the descent ends lower.
+*/
+
+
+inline double tour_length(const double *d, int N, const std::vector<int> &tour) {
+    double cost = d[tour[N-1] * N + tour[0]];
+    for (int i=0; i<N-1; i++) {
+        cost += d[tour[i] * N + tour[i+1]];
+    }
+    return cost;
+}
+
+inline double tour_length(const std::vector<double> &d, int N, const std::vector<int> &tour) {
+    return tour_length(d.data(), N, tour);
+}
+
+// Summed from tour[0] with the closing edge last, the order in which the
+// exact solvers add up a tour; deterministic mode recomputes costs this way
+inline double path_length(const double *d, int N, const int *tour) {
+    double cost = 0;
+    for (int i=1; i<N; i++) {
+        cost += d[tour[i-1] * N + tour[i]];
+    }
+    return cost + d[tour[N-1] * N + tour[0]];
+}
+
+// Nearest unvisited city first, starting from city 0
+inline std::vector<int> nearest_neighbour(const double *d, int N) {
+    std::vector<int> tour(1, 0);
+    std::vector<bool> used(N, false);
+    used[0] = true;
+    for (int k=1; k<N; k++) {
+        int last = tour.back(), next = -1;
+        for (int i=0; i<N; i++) {
+            if (!used[i] && (next < 0 || d[last * N + i] < d[last * N + next])) {
+                next = i;
+            }
+        }
+        used[next] = true;
+        tour.push_back(next);
+    }
+    return tour;
+}
+
+inline std::vector<int> nearest_neighbour(const std::vector<double> &d, int N) {
+    return nearest_neighbour(d.data(), N);
+}
+
+// Starting tour of the anytime modes, so a search stopped at its deadline
+// always has an answer to print. Sets "cost" to its length.
+inline std::vector<int> anytime_tour(const double *d, int N, double &cost) {
+    std::vector<int> tour = nearest_neighbour(d, N);
+    cost = tour_length(d, N, tour);
+    return tour;
+}
+
+// Offers anytime_tour() to "best"
+inline void seed_anytime(Incumbent &best, const double *d, int N) {
+    double cost;
+    std::vector<int> tour = anytime_tour(d, N, cost);
+    best.offer(cost, tour);
+}
+
+// Reverses tour[i+1..j] whenever that shortens the tour. Returns true if
+// anything changed.
+inline bool two_opt(const std::vector<double> &d, int N, std::vector<int> &tour) {
+    bool changed = false;
+    for (bool improved = true; improved; ) {
+        improved = false;
+        for (int i=0; i<N-1; i++) {
+            for (int j=i+2; j<N; j++) {
+                int a = tour[i], b = tour[i+1], c = tour[j], e = tour[(j + 1) % N];
+                if (a == e) {
+                    continue;
+                }
+                if (d[a * N + c] + d[b * N + e] < d[a * N + b] + d[c * N + e] - 1e-9) {
+                    std::reverse(tour.begin() + i + 1, tour.begin() + j + 1);
+                    improved = changed = true;
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+// Moves a segment of 1 to 3 cities, possibly reversed, between two other
+// cities. Returns true if anything changed.
+inline bool or_opt(const std::vector<double> &d, int N, std::vector<int> &tour) {
+    bool changed = false;
+    for (bool improved = true; improved; ) {
+        improved = false;
+        for (int len=1; len<=3 && len<=N-3; len++) {
+            for (int i=0; i+len<=N && !improved; i++) {
+                int s0 = tour[i], sl = tour[i+len-1];
+                int prev = tour[(i + N - 1) % N], next = tour[(i + len) % N];
+                double gain = d[prev * N + s0] + d[sl * N + next] - d[prev * N + next];
+                // Edge (tour[j], tour[j+1]) must lie outside the segment and its neighbours
+                for (int j=(i + len) % N; j!=(i + N - 1) % N; j=(j + 1) % N) {
+                    int a = tour[j], b = tour[(j + 1) % N];
+                    double forward = d[a * N + s0] + d[sl * N + b] - d[a * N + b];
+                    double backward = d[a * N + sl] + d[s0 * N + b] - d[a * N + b];
+                    if (std::min(forward, backward) < gain - 1e-9) {
+                        std::vector<int> seg(tour.begin() + i, tour.begin() + i + len);
+                        if (backward < forward) {
+                            std::reverse(seg.begin(), seg.end());
+                        }
+                        std::vector<int> rest;
+                        rest.reserve(N);
+                        for (int k=0; k<N; k++) {
+                            if (k < i || k >= i + len) {
+                                rest.push_back(tour[k]);
+                            }
+                        }
+                        int at = std::find(rest.begin(), rest.end(), a) - rest.begin();
+                        rest.insert(rest.begin() + at + 1, seg.begin(), seg.end());
+                        tour = rest;
+                        improved = changed = true;
+                        break;
+                    }
+                }
+            }
+        }
+    }
+    return changed;
+}
+
+// Alternates both neighbourhoods until neither improves
+inline double descend(const std::vector<double> &d, int N, std::vector<int> &tour) {
+    if (N >= 4) {
+        two_opt(d, N, tour);
+        while (or_opt(d, N, tour) && two_opt(d, N, tour)) {}
+    }
+    return tour_length(d, N, tour);
+}
+
+// Reconnects three random cuts A|B|C|D as A C B D
+template <typename Rng>
+void double_bridge(std::vector<int> &tour, Rng &rng) {
+    int N = tour.size();
+    std::uniform_int_distribution<int> pick(1, N - 1);
+    int cut[3] = {pick(rng), pick(rng), pick(rng)};
+    std::sort(cut, cut + 3);
+    std::vector<int> next(tour.begin(), tour.begin() + cut[0]);
+    next.insert(next.end(), tour.begin() + cut[1], tour.begin() + cut[2]);
+    next.insert(next.end(), tour.begin() + cut[0], tour.begin() + cut[1]);
+    next.insert(next.end(), tour.begin() + cut[2], tour.end());
+    tour = next;
+}
+
+// Rotates the tour so it starts at city 0 like the exact solvers
+inline void rotate_to_zero(std::vector<int> &tour) {
+    std::rotate(tour.begin(), std::find(tour.begin(), tour.end(), 0), tour.end());
+}
+
+// Iterated local search from "tour" until "deadline", "stall" kicks in a row
+// without improvement or "stop". Every improvement is offered to "best".
+template <typename Rng>
+double iterated_local_search(const std::vector<double> &d, int N, std::vector<int> &tour, std::chrono::steady_clock::time_point deadline, int stall, Rng &rng, Incumbent &best, StopToken *stop = nullptr) {
+    double cost = descend(d, N, tour);
+    rotate_to_zero(tour);
+    best.offer(cost, tour);
+    if (N < 8) {
+        return cost;
+    }
+    for (int fails=0; fails<stall && std::chrono::steady_clock::now() < deadline && !(stop && stop->stop_requested()); fails++) {
+        auto next = tour;
+        double_bridge(next, rng);
+        double next_cost = descend(d, N, next);
+        if (next_cost < cost - 1e-9) {
+            tour = next;
+            cost = next_cost;
+            rotate_to_zero(tour);
+            best.offer(cost, tour);
+            fails = -1;
+        }
+    }
+    return cost;
+}
+
+#endif
@@ -0,0 +1,176 @@
+#ifndef MASTER_WORKER_H
+#define MASTER_WORKER_H
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <mpi.h>
+
+/*
+Dynamic distribution of numbered work units over MPI ranks. Rank 0 only
+schedules: it primes every worker with "prefetch" units and answers each
+request with the next unit, or -1 once everything is handed out. A worker
+asks for a new unit as soon as it starts one, so the next unit is normally
+already there when the current one ends. Every worker records when it was
+busy so the balance can be reported afterwards. A master with nothing
+else to do blocks in MPI_Recv between requests; one that has to poll
+yields the core after every probe, since it usually shares a node with
+workers.
+*/
+
+#define MASTER_WORKER_REQUEST 42
+#define MASTER_WORKER_UNIT 43
+
+
+// Busy intervals of one rank as (start, end, unit) in seconds since the
+// common start
+struct Timeline {
+    std::vector<double> spans;
+    double finish = 0;
+    long units = 0;
+};
+
+// Runs "work(k)" for every k in [0, units) somewhere on "comm" and returns
+// this rank's timeline. The master calls "idle()" while it waits for
+// requests, and so does a single rank between its own units. "block" makes
+// the master wait in MPI_Recv instead, for callers with nothing to do.
+template <typename Work, typename Idle>
+Timeline master_worker(MPI_Comm comm, long units, int prefetch, Work work, Idle idle, bool block = false) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    Timeline timeline;
+    MPI_Barrier(comm);
+    double start = MPI_Wtime();
+    auto run = [&](long k) {
+        double begin = MPI_Wtime() - start;
+        work(k);
+        timeline.spans.insert(timeline.spans.end(), {begin, MPI_Wtime() - start, double(k)});
+        timeline.units++;
+    };
+    if (size == 1) {
+        for (long k=0; k<units; k++) {
+            idle();
+            run(k);
+        }
+    }
+    else if (rank == 0) {
+        long next = 0;
+        // Requests still to come, one per real unit handed out
+        long waiting = 0;
+        for (int w=1; w<size; w++) {
+            for (int p=0; p<prefetch; p++) {
+                long k = next < units ? next++ : -1;
+                MPI_Send(&k, 1, MPI_LONG, w, MASTER_WORKER_UNIT, comm);
+                waiting += k >= 0;
+            }
+        }
+        while (waiting > 0) {
+            int flag = block;
+            MPI_Status status;
+            if (!block) {
+                MPI_Iprobe(MPI_ANY_SOURCE, MASTER_WORKER_REQUEST, comm, &flag, &status);
+            }
+            if (!flag) {
+                idle();
+                std::this_thread::yield();
+                continue;
+            }
+            MPI_Recv(nullptr, 0, MPI_LONG, block ? MPI_ANY_SOURCE : status.MPI_SOURCE, MASTER_WORKER_REQUEST, comm, &status);
+            int w = status.MPI_SOURCE;
+            long k = next < units ? next++ : -1;
+            MPI_Send(&k, 1, MPI_LONG, w, MASTER_WORKER_UNIT, comm);
+            waiting += (k >= 0) - 1;
+        }
+    }
+    else {
+        std::deque<long> queue;
+        // Replies not received yet
+        long expected = prefetch;
+        auto receive = [&](bool block) {
+            int flag = block;
+            if (!block) {
+                MPI_Iprobe(0, MASTER_WORKER_UNIT, comm, &flag, MPI_STATUS_IGNORE);
+            }
+            if (flag) {
+                long k;
+                MPI_Recv(&k, 1, MPI_LONG, 0, MASTER_WORKER_UNIT, comm, MPI_STATUS_IGNORE);
+                queue.push_back(k);
+                expected--;
+            }
+            return flag;
+        };
+        while (true) {
+            while (receive(false)) {}
+            if (queue.empty()) {
+                receive(true);
+            }
+            long k = queue.front();
+            queue.pop_front();
+            if (k < 0) {
+                break;
+            }
+            MPI_Send(nullptr, 0, MPI_LONG, 0, MASTER_WORKER_REQUEST, comm);
+            expected++;
+            run(k);
+        }
+        // Units arrive in order, everything after the first -1 is -1
+        while (expected > 0) {
+            receive(true);
+        }
+    }
+    timeline.finish = MPI_Wtime() - start;
+    return timeline;
+}
+
+// Prints the spread of busy and idle time over the workers to "out" and,
+// with a path, writes every busy interval as "rank,unit,start,end" lines.
+// Collective.
+inline void report_timelines(MPI_Comm comm, const Timeline &timeline, std::ostream &out, const std::string &path) {
+    int rank, size;
+    MPI_Comm_rank(comm, &rank);
+    MPI_Comm_size(comm, &size);
+    int count = timeline.spans.size();
+    std::vector<int> counts(size), offsets(size);
+    MPI_Gather(&count, 1, MPI_INT, counts.data(), 1, MPI_INT, 0, comm);
+    for (int r=1; r<size; r++) {
+        offsets[r] = offsets[r-1] + counts[r-1];
+    }
+    std::vector<double> spans(rank == 0 ? offsets[size-1] + counts[size-1] : 0);
+    MPI_Gatherv(timeline.spans.data(), count, MPI_DOUBLE, spans.data(), counts.data(), offsets.data(), MPI_DOUBLE, 0, comm);
+    std::vector<double> finish(size);
+    MPI_Gather(&timeline.finish, 1, MPI_DOUBLE, finish.data(), 1, MPI_DOUBLE, 0, comm);
+    if (rank != 0) {
+        return;
+    }
+    std::ofstream csv;
+    if (!path.empty()) {
+        csv.open(path);
+        csv << "rank,unit,start,end" << std::endl;
+    }
+    // The master does no units unless it runs alone
+    int first = (size == 1) ? 0 : 1;
+    double busy_min = 1e300, busy_max = 0, busy_sum = 0, idle_max = 0, finish_min = 1e300, finish_max = 0;
+    for (int r=first; r<size; r++) {
+        double busy = 0;
+        for (int i=offsets[r]; i<offsets[r]+counts[r]; i+=3) {
+            busy += spans[i+1] - spans[i];
+            if (csv.is_open()) {
+                csv << r << "," << long(spans[i+2]) << "," << spans[i] << "," << spans[i+1] << std::endl;
+            }
+        }
+        busy_min = std::min(busy_min, busy);
+        busy_max = std::max(busy_max, busy);
+        busy_sum += busy;
+        idle_max = std::max(idle_max, finish[r] - busy);
+        finish_min = std::min(finish_min, finish[r]);
+        finish_max = std::max(finish_max, finish[r]);
+    }
+    out << "workers " << size - first << ", busy min/mean/max " << busy_min << "/" << busy_sum / (size - first) << "/" << busy_max << " s, idle max " << idle_max << " s, finish " << finish_min << "-" << finish_max << " s";
+}
+
+#endif
@@ -0,0 +1,120 @@
+#ifndef MEET_MIDDLE_H
+#define MEET_MIDDLE_H
+
+#include <vector>
+#include <string>
+#include <limits>
+#include <algorithm>
+#include <omp.h>
+
+#include "held-karp.h"
+
+/*
+Meet-in-the-middle exact solver. Every tour 0 -> ... -> m -> ... -> 0 is cut
+at a middle city m into two half paths out of city 0: one through a set S
+of k cities ending at m, the other through the remaining cities plus m,
+also ending at m. Both halves are entries of the Held-Karp layers up to k
+(about half of the full table), and the join pairs each (S, m) with its
+complement entry directly by subset rank.
+The half table is about 60% of the full one. Backed by files, only about
+the two largest adjacent layers are resident at once (a third of the full
+table) and the rest stays in the files; in anonymous memory it is resident
+as a whole.
+*/
+
+
+// Bytes of the half table for N cities
+inline size_t meet_middle_bytes(int N, size_t cost_size) {
+    int n = N - 1;
+    int k = (n + 2) / 2;
+    SubsetRank sr(std::max(n, 1));
+    size_t bytes = 0;
+    for (int j=1; j<=k && j<=n; j++) {
+        bytes += sr.choose(n, j) * j * cost_size;
+    }
+    return bytes;
+}
+
+template <typename T>
+double meet_middle(std::vector<double> &d, int N, std::vector<int> &tour, const std::string &dir = "", StopToken *stop = nullptr) {
+    tour.assign(N, 0);
+    if (N <= 2) {
+        for (int i=0; i<N; i++) {
+            tour[i] = i;
+        }
+        return N == 2 ? 2 * d[1] : 0;
+    }
+    int n = N - 1;
+    // First half holds k cities, the second n - k + 1 <= k (m is in both)
+    int k = (n + 2) / 2;
+    int k2 = n - k + 1;
+    SubsetRank sr(n);
+    std::vector<DPLayer<T> *> layers;
+    double result = std::numeric_limits<double>::infinity();
+    if (held_karp_layers<T>(d, N, k, sr, layers, dir, stop)) {
+        uint32_t full = (1u << n) - 1;
+        uint64_t count = sr.choose(n, k);
+        const T *first = layers[k]->data;
+        const T *second = layers[k2]->data;
+        T best = std::numeric_limits<T>::max();
+        uint32_t best_S = 0;
+        int best_m = 0;
+        #pragma omp parallel
+        {
+            T local = std::numeric_limits<T>::max();
+            uint32_t local_S = 0;
+            int local_m = 0;
+            // Layer k is joined in chunks so a file backed one never has to be
+            // resident as a whole
+            for (uint64_t lo=0; lo<count; lo+=HELD_KARP_CHUNK) {
+                uint64_t hi = std::min<uint64_t>(count, lo + HELD_KARP_CHUNK);
+                #pragma omp for schedule(dynamic, 4096)
+                for (uint64_t r=lo; r<hi; r++) {
+                    uint32_t S = sr.unrank(r, k);
+                    uint32_t R = full & ~S;
+                    int i = 0;
+                    for (uint32_t m=S; m; m &= m - 1, i++) {
+                        int bit = __builtin_ctz(m);
+                        uint32_t other = R | (1u << bit);
+                        int pos = __builtin_popcount(other & ((1u << bit) - 1));
+                        T c = first[r * k + i] + second[sr.rank(other) * k2 + pos];
+                        if (c < local) {
+                            local = c;
+                            local_S = S;
+                            local_m = bit + 1;
+                        }
+                    }
+                }
+                #pragma omp single
+                {
+                    layers[k]->release(lo * k, hi * k);
+                }
+            }
+            #pragma omp critical
+            {
+                if (local < best || (local == best && (local_S < best_S || (local_S == best_S && local_m < best_m)))) {
+                    best = local;
+                    best_S = local_S;
+                    best_m = local_m;
+                }
+            }
+        }
+        // Path 0 -> ... -> m through S, then the second half walked backwards
+        std::vector<int> half(N, 0);
+        held_karp_path<T>(d, N, sr, layers, best_S, best_m, tour);
+        held_karp_path<T>(d, N, sr, layers, (full & ~best_S) | (1u << (best_m - 1)), best_m, half);
+        for (int i=1; i<k2; i++) {
+            tour[k + i] = half[k2 - i];
+        }
+        if (tour[1] > tour[N-1]) {
+            std::reverse(tour.begin() + 1, tour.end());
+        }
+        result = best;
+    }
+    for (auto layer : layers) {
+        delete layer;
+    }
+    return result;
+}
+
+#endif
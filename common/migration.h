@@ -0,0 +1,115 @@
+#ifndef MIGRATION_H
+#define MIGRATION_H
+
+#include <list>
+#include <vector>
+#include <random>
+#include <mpi.h>
+
+/*
+Tour migration between the islands (ranks) of a distributed metaheuristic.
+A migrant is sent to the next rank of a ring, or to a random other rank,
+with MPI_Issend and the island goes on evolving while it travels; arrivals
+are picked up with MPI_Iprobe whenever the island checks. finish() drains
+like SharedBound: wait for the own sends while receiving, then receive
+until everyone is past an MPI_Ibarrier.
+*/
+
+#define MIGRATION_TAG 47
+
+
+class Migration {
+public:
+    Migration(MPI_Comm comm, int N, bool random, unsigned seed) : sent(0), received(0), comm(comm), N(N), random(random), rng(seed) {
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+    }
+
+    // Sends a copy of "tour" away, a no-op on a single rank
+    void emigrate(double cost, const std::vector<int> &tour) {
+        release();
+        if (size == 1) {
+            return;
+        }
+        int to = (rank + 1) % size;
+        if (random) {
+            to = std::uniform_int_distribution<int>(0, size - 2)(rng);
+            to += (to >= rank);
+        }
+        outbox.push_back(Message{std::vector<double>(N + 1), MPI_REQUEST_NULL});
+        Message &m = outbox.back();
+        m.data[0] = cost;
+        for (int i=0; i<N; i++) {
+            m.data[i+1] = tour[i];
+        }
+        MPI_Issend(m.data.data(), N + 1, MPI_DOUBLE, to, MIGRATION_TAG, comm, &m.request);
+        sent++;
+    }
+
+    // Takes one migrant that has arrived, false if there is none
+    bool immigrate(double &cost, std::vector<int> &tour) {
+        int flag;
+        MPI_Status status;
+        MPI_Iprobe(MPI_ANY_SOURCE, MIGRATION_TAG, comm, &flag, &status);
+        if (!flag) {
+            return false;
+        }
+        std::vector<double> data(N + 1);
+        MPI_Recv(data.data(), N + 1, MPI_DOUBLE, status.MPI_SOURCE, MIGRATION_TAG, comm, MPI_STATUS_IGNORE);
+        cost = data[0];
+        tour.resize(N);
+        for (int i=0; i<N; i++) {
+            tour[i] = int(data[i+1]);
+        }
+        received++;
+        return true;
+    }
+
+    // Collective, called when the island stops evolving. Late migrants are
+    // handed to "adopt(cost, tour)".
+    template <typename Adopt>
+    void finish(Adopt adopt) {
+        double cost;
+        std::vector<int> tour;
+        while (!outbox.empty()) {
+            while (immigrate(cost, tour)) {
+                adopt(cost, tour);
+            }
+            release();
+        }
+        MPI_Request barrier;
+        MPI_Ibarrier(comm, &barrier);
+        for (int done = 0; !done; ) {
+            while (immigrate(cost, tour)) {
+                adopt(cost, tour);
+            }
+            MPI_Test(&barrier, &done, MPI_STATUS_IGNORE);
+        }
+    }
+
+    long sent, received;
+
+private:
+    struct Message {
+        std::vector<double> data;
+        MPI_Request request;
+    };
+
+    // Frees the buffers of the sends that completed
+    void release() {
+        for (auto it=outbox.begin(); it!=outbox.end(); ) {
+            int flag;
+            MPI_Test(&it->request, &flag, MPI_STATUS_IGNORE);
+            it = flag ? outbox.erase(it) : std::next(it);
+        }
+    }
+
+    MPI_Comm comm;
+    int rank, size, N;
+    bool random;
+    std::mt19937 rng;
+    // std::list so buffers stay put while their sends are pending
+    std::list<Message> outbox;
+};
+
+#endif
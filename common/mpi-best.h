@@ -0,0 +1,60 @@
+#ifndef MPI_BEST_H
+#define MPI_BEST_H
+
+#include <vector>
+#include <algorithm>
+#include <mpi.h>
+
+/*
+Best tour over all ranks in O(log P): an MPI_MINLOC all-reduce of the
+(cost, rank) pairs picks the winner, then only its tour is broadcast. Every
+rank ends up with the same tour, so the same call serves the final
+collection and a periodic exchange of elite tours during a run.
+*/
+
+
+// Collective. Replaces "cost" and "tour" with the lowest cost tour of any
+// rank (the lowest rank wins ties) and returns the rank it came from.
+// "tour" is resized to N on every rank.
+inline int allreduce_best(MPI_Comm comm, int N, double &cost, std::vector<int> &tour) {
+    struct {
+        double cost;
+        int rank;
+    } in, out;
+    in.cost = cost;
+    MPI_Comm_rank(comm, &in.rank);
+    MPI_Allreduce(&in, &out, 1, MPI_DOUBLE_INT, MPI_MINLOC, comm);
+    tour.resize(N, -1);
+    MPI_Bcast(tour.data(), N, MPI_INT, out.rank, comm);
+    cost = out.cost;
+    return out.rank;
+}
+
+// Collective. Like allreduce_best, but ties go to the lexicographically
+// smaller tour, so the winner does not depend on which rank found it. The
+// costs are all-gathered and scanned in rank order, the tours only when
+// several ranks share the lowest cost.
+inline int allreduce_best_ordered(MPI_Comm comm, int N, double &cost, std::vector<int> &tour) {
+    int size;
+    MPI_Comm_size(comm, &size);
+    std::vector<double> costs(size);
+    MPI_Allgather(&cost, 1, MPI_DOUBLE, costs.data(), 1, MPI_DOUBLE, comm);
+    double low = *std::min_element(costs.begin(), costs.end());
+    int winner = std::find(costs.begin(), costs.end(), low) - costs.begin();
+    tour.resize(N, -1);
+    if (std::count(costs.begin(), costs.end(), low) > 1) {
+        std::vector<int> all(size_t(N) * size);
+        MPI_Allgather(tour.data(), N, MPI_INT, all.data(), N, MPI_INT, comm);
+        for (int r=winner+1; r<size; r++) {
+            const int *t = &all[size_t(r) * N], *w = &all[size_t(winner) * N];
+            if (costs[r] == low && std::lexicographical_compare(t, t + N, w, w + N)) {
+                winner = r;
+            }
+        }
+    }
+    MPI_Bcast(tour.data(), N, MPI_INT, winner, comm);
+    cost = low;
+    return winner;
+}
+
+#endif
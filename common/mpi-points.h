@@ -0,0 +1,42 @@
+#ifndef MPI_POINTS_H
+#define MPI_POINTS_H
+
+#include <vector>
+#include <mpi.h>
+
+/*
+Flat transfers of the instance. Boost.Serialization archives a
+vector<vector<double>> one element at a time. Here the coordinates travel
+as one structure-of-arrays block of doubles (all x, then all y, ...) in a
+single MPI_Bcast, so no rank ever packs more than a memcpy's worth.
+*/
+
+
+// Collective. "points" only has to be filled on "root", every point must
+// have the same number of coordinates.
+inline void bcast_points(MPI_Comm comm, std::vector<std::vector<double>> &points, int root) {
+    int rank;
+    MPI_Comm_rank(comm, &rank);
+    int shape[2] = {int(points.size()), points.empty() ? 0 : int(points[0].size())};
+    MPI_Bcast(shape, 2, MPI_INT, root, comm);
+    int N = shape[0], width = shape[1];
+    std::vector<double> soa(size_t(N) * width);
+    if (rank == root) {
+        for (int i=0; i<N; i++) {
+            for (int k=0; k<width; k++) {
+                soa[size_t(k) * N + i] = points[i][k];
+            }
+        }
+    }
+    MPI_Bcast(soa.data(), soa.size(), MPI_DOUBLE, root, comm);
+    if (rank != root) {
+        points.assign(N, std::vector<double>(width));
+        for (int i=0; i<N; i++) {
+            for (int k=0; k<width; k++) {
+                points[i][k] = soa[size_t(k) * N + i];
+            }
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef NODE_MATRIX_H
+#define NODE_MATRIX_H
+
+#include <vector>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <mpi.h>
+
+/*
+One distance matrix per node instead of one per rank. The ranks of a node
+(MPI_COMM_TYPE_SHARED) map a single MPI_Win_allocate_shared window, fill
+its rows round robin and read it in place afterwards, so memory per node no
+longer grows with the number of ranks on it.
+*/
+
+
+// Resident set size of this process in KB, 0 where /proc is missing
+inline long resident_kb() {
+    std::ifstream status("/proc/self/status");
+    std::string key;
+    long kb = 0;
+    while (status >> key) {
+        if (key == "VmRSS:") {
+            status >> kb;
+            break;
+        }
+        status.ignore(1 << 10, '\n');
+    }
+    return kb;
+}
+
+class NodeMatrix {
+public:
+    // Collective over "comm". d(i, j) gives the distance between cities i
+    // and j, each rank of a node computes every node_size-th row.
+    template <typename Dist>
+    NodeMatrix(MPI_Comm comm, int N, Dist dist) : N(N) {
+        MPI_Barrier(comm);
+        double start = MPI_Wtime();
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_split_type(comm, MPI_COMM_TYPE_SHARED, rank, MPI_INFO_NULL, &node);
+        MPI_Comm_rank(node, &node_rank);
+        MPI_Comm_size(node, &node_size);
+        // The node's first rank owns the whole block, the others map it
+        MPI_Aint bytes = (node_rank == 0) ? MPI_Aint(N) * N * sizeof(double) : 0;
+        double *base;
+        MPI_Win_allocate_shared(bytes, sizeof(double), MPI_INFO_NULL, node, &base, &win);
+        MPI_Aint size;
+        int unit;
+        MPI_Win_shared_query(win, 0, &size, &unit, &d);
+        MPI_Win_fence(0, win);
+        for (int i=node_rank; i<N; i+=node_size) {
+            for (int j=0; j<N; j++) {
+                d[size_t(i) * N + j] = dist(i, j);
+            }
+        }
+        MPI_Win_fence(0, win);
+        MPI_Barrier(comm);
+        build_time = MPI_Wtime() - start;
+    }
+
+    ~NodeMatrix() {
+        MPI_Win_free(&win);
+        MPI_Comm_free(&node);
+    }
+
+    NodeMatrix(const NodeMatrix &) = delete;
+    NodeMatrix &operator=(const NodeMatrix &) = delete;
+
+    const double *data() const {
+        return d;
+    }
+
+    // Collective. Prints the number of nodes, the matrix size, the build
+    // time and the largest resident memory of a node (summed over its ranks,
+    // shared pages count once per rank that touched them).
+    void report(MPI_Comm comm, std::ostream &out) const {
+        int rank;
+        MPI_Comm_rank(comm, &rank);
+        long rss = resident_kb(), node_rss = 0, max_rss = 0;
+        MPI_Reduce(&rss, &node_rss, 1, MPI_LONG, MPI_SUM, 0, node);
+        int leader = node_rank == 0, nodes = 0;
+        MPI_Reduce(&leader, &nodes, 1, MPI_INT, MPI_SUM, 0, comm);
+        long contribution = leader ? node_rss : 0;
+        MPI_Reduce(&contribution, &max_rss, 1, MPI_LONG, MPI_MAX, 0, comm);
+        if (rank == 0) {
+            out << "distance matrix: " << nodes << " node(s), " << double(N) * N * sizeof(double) / 1024 << " KB per node, built in " << build_time << " s, resident at most " << max_rss << " KB per node";
+        }
+    }
+
+    int N;
+    double build_time;
+
+private:
+    MPI_Comm node;
+    MPI_Win win;
+    int node_rank, node_size;
+    double *d;
+};
+
+#endif
@@ -0,0 +1,170 @@
+#ifndef PERM_RANK_H
+#define PERM_RANK_H
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include "stop-token.h"
+
+/*
+Factorial number system ranking of permutations, used to cut the tour
+space into contiguous ranges of any size.
+The space is the (N-1)!/2 canonical tours, each tour in one direction
+only: tour[0] = 0, a pair (tour[1], tour[N-1]) with tour[1] < tour[N-1],
+and any permutation of the other N-3 cities in between. Rank r = pair * (N-3)! + rank of the middle.
+*/
+
+
+inline uint64_t factorial(int n) {
+    uint64_t f = 1;
+    for (int i=2; i<=n; i++) {
+        f *= i;
+    }
+    return f;
+}
+
+// Lexicographic rank of a permutation of "items" (Lehmer code)
+inline uint64_t rank_permutation(const int *perm, int m) {
+    uint64_t r = 0;
+    for (int i=0; i<m; i++) {
+        int smaller = 0;
+        for (int j=i+1; j<m; j++) {
+            smaller += perm[j] < perm[i];
+        }
+        r += smaller * factorial(m - 1 - i);
+    }
+    return r;
+}
+
+// Writes the permutation of the sorted "items" with lexicographic rank r
+inline void unrank_permutation(uint64_t r, std::vector<int> items, int *out) {
+    int m = items.size();
+    for (int i=0; i<m; i++) {
+        uint64_t f = factorial(m - 1 - i);
+        int k = r / f;
+        r %= f;
+        out[i] = items[k];
+        items.erase(items.begin() + k);
+    }
+}
+
+// Advances to the next permutation in lexicographic order and returns the
+// leftmost position that changed, or -1 after the last permutation.
+inline int next_permutation_at(int *perm, int m) {
+    int i = m - 2;
+    while (i >= 0 && perm[i] >= perm[i+1]) {
+        i--;
+    }
+    if (i < 0) {
+        return -1;
+    }
+    int j = m - 1;
+    while (perm[j] <= perm[i]) {
+        j--;
+    }
+    std::swap(perm[i], perm[j]);
+    std::reverse(perm + i + 1, perm + m);
+    return i;
+}
+
+
+// First rank of part i when "size" ranks are cut into "parts" ranges whose
+// sizes differ by at most one
+inline uint64_t range_begin(uint64_t size, uint64_t parts, uint64_t i) {
+    return i * (size / parts) + std::min(i, size % parts);
+}
+
+
+struct TourSpace {
+    // Needs N >= 3, ranks fit 64 bits up to N = 21
+    TourSpace(int N) : N(N), middle(factorial(N - 3)), size((uint64_t)(N - 1) * (N - 2) / 2 * factorial(N - 3)) {}
+
+    // Canonical tour with rank r
+    void unrank(uint64_t r, std::vector<int> &tour) const {
+        tour.assign(N, 0);
+        uint64_t pair = r / middle;
+        int a = 1, c = 2;
+        for (;; a++) {
+            uint64_t pairs = N - 1 - a;
+            if (pair < pairs) {
+                c = a + 1 + pair;
+                break;
+            }
+            pair -= pairs;
+        }
+        tour[1] = a;
+        tour[N-1] = c;
+        std::vector<int> items;
+        for (int i=1; i<N; i++) {
+            if (i != a && i != c) {
+                items.push_back(i);
+            }
+        }
+        unrank_permutation(r % middle, items, &tour[2]);
+    }
+
+    uint64_t rank(const std::vector<int> &tour) const {
+        int a = tour[1], c = tour[N-1];
+        uint64_t pair = 0;
+        for (int i=1; i<a; i++) {
+            pair += N - 1 - i;
+        }
+        pair += c - a - 1;
+        return pair * middle + rank_permutation(&tour[2], N - 3);
+    }
+
+    // Moves "tour" to the next rank and returns the leftmost changed position
+    int next(std::vector<int> &tour, uint64_t r) const {
+        int k = next_permutation_at(&tour[2], N - 3);
+        if (k >= 0) {
+            return k + 2;
+        }
+        unrank(r + 1, tour);
+        return 1;
+    }
+
+    int N;
+    uint64_t middle;
+    uint64_t size;
+};
+
+// Exhaustive search of the tours with rank in [lo, hi). Partial path costs are
+// kept per position so each step only recomputes the suffix that changed.
+// "stop" is polled every 4096 tours; returns the first rank not enumerated.
+// With "ties" an equal cost goes to the lexicographically smaller tour, so
+// the result does not depend on where the range was cut.
+inline uint64_t enumerate_range(const double *d, int N, uint64_t lo, uint64_t hi, double &best_cost, std::vector<int> &best_sol, StopToken *stop = nullptr, bool ties = false) {
+    if (lo >= hi) {
+        return hi;
+    }
+    TourSpace space(N);
+    std::vector<int> tour;
+    std::vector<double> pre(N, 0);
+    space.unrank(lo, tour);
+    int changed = 1;
+    for (uint64_t r=lo; ; ) {
+        for (int i=changed; i<N; i++) {
+            pre[i] = pre[i-1] + d[tour[i-1] * N + tour[i]];
+        }
+        double cost = pre[N-1] + d[tour[N-1] * N];
+        if (cost < best_cost || (ties && cost == best_cost && tour < best_sol)) {
+            best_cost = cost;
+            best_sol = tour;
+        }
+        if (++r == hi) {
+            break;
+        }
+        if (stop && (r & 4095) == 0 && stop->stop_requested()) {
+            return r;
+        }
+        changed = space.next(tour, r - 1);
+    }
+    return hi;
+}
+
+inline uint64_t enumerate_range(const std::vector<double> &d, int N, uint64_t lo, uint64_t hi, double &best_cost, std::vector<int> &best_sol, StopToken *stop = nullptr, bool ties = false) {
+    return enumerate_range(d.data(), N, lo, hi, best_cost, best_sol, stop, ties);
+}
+
+#endif
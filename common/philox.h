@@ -0,0 +1,118 @@
+#ifndef PHILOX_H
+#define PHILOX_H
+
+#include <array>
+#include <cstdint>
+#include <utility>
+
+/*
+Counter-based random numbers (Philox4x32-10, Salmon et al., SC'11). The
+numbers are a pure function of (seed, stream, substream, position), so every
+task derives its own generator from its task index instead of sharing one:
+no state to contend on and the same draws whichever thread or rank runs the
+task. Each counter step yields four 32-bit words; philox_shuffle consumes
+them four swaps at a time and bounds them with a multiply instead of a
+division (Lemire, 2019).
+*/
+
+
+class Philox {
+public:
+    typedef uint32_t result_type;
+
+    // Independent streams for distinct (stream, substream), e.g. a task
+    // index, or a rank and a thread
+    Philox(uint64_t seed, uint32_t stream, uint32_t substream = 0) : key{uint32_t(seed), uint32_t(seed >> 32)}, counter{0, 0, stream, substream}, used(4) {}
+
+    static constexpr result_type min() {
+        return 0;
+    }
+
+    static constexpr result_type max() {
+        return UINT32_MAX;
+    }
+
+    result_type operator()() {
+        if (used == 4) {
+            refill();
+        }
+        return out[used++];
+    }
+
+    // The next four words, a whole block when the previous one is used up
+    std::array<uint32_t, 4> next4() {
+        if (used == 4) {
+            refill();
+            used = 4;
+            return out;
+        }
+        std::array<uint32_t, 4> r;
+        for (auto &w : r) {
+            w = (*this)();
+        }
+        return r;
+    }
+
+    // Uniform in [0, n), n > 0, without modulo bias
+    uint32_t below(uint32_t n) {
+        return bounded((*this)(), n);
+    }
+
+    // Maps the word "r" to [0, n), drawing again in the rare biased case
+    uint32_t bounded(uint32_t r, uint32_t n) {
+        uint64_t m = uint64_t(r) * n;
+        if (uint32_t(m) < n) {
+            uint32_t threshold = -n % n;
+            while (uint32_t(m) < threshold) {
+                m = uint64_t((*this)()) * n;
+            }
+        }
+        return m >> 32;
+    }
+
+private:
+    void refill() {
+        uint32_t c[4] = {counter[0], counter[1], counter[2], counter[3]};
+        uint32_t k[2] = {key[0], key[1]};
+        for (int round=0; round<10; round++) {
+            uint64_t p0 = uint64_t(0xD2511F53) * c[0], p1 = uint64_t(0xCD9E8D57) * c[2];
+            uint32_t next[4] = {uint32_t(p1 >> 32) ^ c[1] ^ k[0], uint32_t(p1), uint32_t(p0 >> 32) ^ c[3] ^ k[1], uint32_t(p0)};
+            for (int i=0; i<4; i++) {
+                c[i] = next[i];
+            }
+            k[0] += 0x9E3779B9;
+            k[1] += 0xBB67AE85;
+        }
+        for (int i=0; i<4; i++) {
+            out[i] = c[i];
+        }
+        // The position is the low 64 bits of the counter
+        if (++counter[0] == 0) {
+            counter[1]++;
+        }
+        used = 0;
+    }
+
+    uint32_t key[2];
+    uint32_t counter[4];
+    std::array<uint32_t, 4> out;
+    int used;
+};
+
+// Fisher-Yates shuffle of [first, last), four swaps per Philox block
+template <typename It>
+void philox_shuffle(It first, It last, Philox &rng) {
+    uint32_t i = last - first;
+    while (i > 1) {
+        auto r = rng.next4();
+        uint32_t j[4];
+        for (int k=0; k<4; k++) {
+            j[k] = (i > uint32_t(k)) ? rng.bounded(r[k], i - k) : 0;
+        }
+        for (int k=0; k<4 && i>1; k++, i--) {
+            std::swap(first[i-1], first[j[k]]);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,172 @@
+#ifndef PREPROCESS_H
+#define PREPROCESS_H
+
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <cstdint>
+
+#include "local-search.h"
+
+/*
+Preprocessing for the exact solvers (at most 32 cities).
+- An optimal Euclidean tour visits the convex hull vertices in hull order,
+  so a partial path whose hull vertices are out of cyclic order is pruned.
+- An edge (i, j) is dropped when even the cheapest degree-2 completion that
+  uses it costs more than a heuristic tour, which leaves a sparse bitmap of
+  the edges an optimal tour can use.
+*/
+
+
+// Hull vertices met so far on the current path, in both directions
+struct HullState {
+    int first;
+    int last_plus;
+    int last_minus;
+    bool plus;
+    bool minus;
+};
+
+struct Preprocess {
+    int N;
+    // Convex hull in counter-clockwise order and the position of each city on it
+    std::vector<int> hull;
+    std::vector<int> hull_pos;
+    // Bit j of allowed[i] is set when edge (i, j) may be in an optimal tour
+    std::vector<uint32_t> allowed;
+    // Cost of the heuristic tour used for the elimination
+    double upper;
+
+    bool edge(int i, int j) const {
+        return (allowed[i] >> j) & 1;
+    }
+
+    HullState hull_start() const {
+        HullState st{-1, 0, 0, true, true};
+        hull_step(st, 0);
+        return st;
+    }
+
+    // Updates "st" with the next city, false when the hull order is broken
+    bool hull_step(HullState &st, int city) const {
+        int p = hull_pos[city];
+        if (p < 0) {
+            return true;
+        }
+        int H = hull.size();
+        if (st.first < 0) {
+            st.first = p;
+            return true;
+        }
+        int off_plus = (p - st.first + H) % H;
+        int off_minus = (st.first - p + H) % H;
+        st.plus = st.plus && off_plus > st.last_plus;
+        st.minus = st.minus && off_minus > st.last_minus;
+        st.last_plus = off_plus;
+        st.last_minus = off_minus;
+        return st.plus || st.minus;
+    }
+
+    void report(std::ostream &out) const {
+        long edges = 0;
+        for (int i=0; i<N; i++) {
+            edges += __builtin_popcount(allowed[i]);
+        }
+        out << "hull " << hull.size() << " cities, allowed edges " << edges / 2 << " of " << N * (N - 1) / 2
+            << ", branching " << N - 1 << " -> " << (N ? double(edges) / N : 0) << std::endl;
+    }
+};
+
+inline double cross(const std::vector<double> &o, const std::vector<double> &a, const std::vector<double> &b) {
+    return (a[0] - o[0]) * (b[1] - o[1]) - (a[1] - o[1]) * (b[0] - o[0]);
+}
+
+// Andrew's monotone chain, collinear points are left out of the hull
+inline std::vector<int> convex_hull(const std::vector<std::vector<double>> &points) {
+    int N = points.size();
+    std::vector<int> idx(N);
+    for (int i=0; i<N; i++) {
+        idx[i] = i;
+    }
+    std::sort(idx.begin(), idx.end(), [&](int a, int b) {
+        return points[a] < points[b];
+    });
+    std::vector<int> hull(2 * N);
+    int k = 0;
+    for (int i=0; i<N; i++) {
+        while (k >= 2 && cross(points[hull[k-2]], points[hull[k-1]], points[idx[i]]) <= 0) {
+            k--;
+        }
+        hull[k++] = idx[i];
+    }
+    for (int i=N-2, t=k+1; i>=0; i--) {
+        while (k >= t && cross(points[hull[k-2]], points[hull[k-1]], points[idx[i]]) <= 0) {
+            k--;
+        }
+        hull[k++] = idx[i];
+    }
+    hull.resize(std::max(k - 1, 0));
+    return hull;
+}
+
+inline Preprocess preprocess(const std::vector<std::vector<double>> &points, const std::vector<double> &d) {
+    int N = points.size();
+    Preprocess prep{N, {}, std::vector<int>(N, -1), std::vector<uint32_t>(N, 0), 0};
+    if (N >= 4) {
+        prep.hull = convex_hull(points);
+        if (prep.hull.size() < 3) {
+            prep.hull.clear();
+        }
+        for (size_t p=0; p<prep.hull.size(); p++) {
+            prep.hull_pos[prep.hull[p]] = p;
+        }
+    }
+    for (int i=0; i<N; i++) {
+        prep.allowed[i] = ((N == 32) ? 0xffffffffu : ((1u << N) - 1)) & ~(1u << i);
+    }
+    if (N < 4) {
+        return prep;
+    }
+    // Nearest neighbour tour improved with 2-opt
+    std::vector<int> tour = nearest_neighbour(d, N);
+    two_opt(d, N, tour);
+    prep.upper = tour_length(d, N, tour);
+    // Two cheapest edges at every city and their sum over all cities
+    std::vector<int> first(N);
+    std::vector<double> m1(N), m2(N);
+    double base = 0;
+    for (int i=0; i<N; i++) {
+        int a = -1, b = -1;
+        for (int j=0; j<N; j++) {
+            if (j == i) {
+                continue;
+            }
+            if (a < 0 || d[i * N + j] < d[i * N + a]) {
+                b = a;
+                a = j;
+            }
+            else if (b < 0 || d[i * N + j] < d[i * N + b]) {
+                b = j;
+            }
+        }
+        first[i] = a;
+        m1[i] = d[i * N + a];
+        m2[i] = d[i * N + b];
+        base += m1[i] + m2[i];
+    }
+    for (int i=0; i<N; i++) {
+        for (int j=i+1; j<N; j++) {
+            // Both endpoints have to pay for (i, j) plus their cheapest other edge
+            double at_i = d[i * N + j] + (first[i] == j ? m2[i] : m1[i]);
+            double at_j = d[i * N + j] + (first[j] == i ? m2[j] : m1[j]);
+            double bound = 0.5 * (base - m1[i] - m2[i] - m1[j] - m2[j] + at_i + at_j);
+            if (bound > prep.upper * (1 + 1e-9)) {
+                prep.allowed[i] &= ~(1u << j);
+                prep.allowed[j] &= ~(1u << i);
+            }
+        }
+    }
+    return prep;
+}
+
+#endif
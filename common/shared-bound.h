@@ -0,0 +1,114 @@
+#ifndef SHARED_BOUND_H
+#define SHARED_BOUND_H
+
+#include <list>
+#include <vector>
+#include <limits>
+#include <mpi.h>
+
+/*
+Incumbent cost shared by the ranks of a distributed branch and bound without
+ever blocking the search. An improvement is sent to every other rank with
+MPI_Issend and incoming costs are picked up every "poll" nodes with
+MPI_Iprobe. finish() is a nonblocking consensus: a rank enters MPI_Ibarrier
+once all its sends are matched and keeps receiving until everyone has, so no
+message is left in flight when the search ends.
+*/
+
+#define SHARED_BOUND_TAG 41
+
+
+class SharedBound {
+public:
+    SharedBound(MPI_Comm comm, long poll) : nodes(0), sent(0), received(0), adopted(0), comm(comm), poll(poll), best(std::numeric_limits<double>::infinity()) {
+        MPI_Comm_rank(comm, &rank);
+        MPI_Comm_size(comm, &size);
+    }
+
+    // Best cost known to this rank, its own or another rank's
+    double cost() const {
+        return best;
+    }
+
+    // Lowers the bound without telling anybody, for a start every rank shares
+    void seed(double c) {
+        best = std::min(best, c);
+    }
+
+    // A tour of cost "c" was found here, tells every other rank
+    void improve(double c) {
+        if (c >= best) {
+            return;
+        }
+        best = c;
+        if (size == 1) {
+            return;
+        }
+        outbox.push_back(Message{c, std::vector<MPI_Request>(size - 1)});
+        Message &m = outbox.back();
+        for (int r=0, k=0; r<size; r++) {
+            if (r != rank) {
+                MPI_Issend(&m.cost, 1, MPI_DOUBLE, r, SHARED_BOUND_TAG, comm, &m.requests[k++]);
+            }
+        }
+        sent += size - 1;
+    }
+
+    // Counts a node, polls every "poll" nodes
+    void node() {
+        if (++nodes % poll == 0) {
+            progress();
+        }
+    }
+
+    // Adopts every cost that has arrived and releases the sends that completed
+    void progress() {
+        int flag;
+        MPI_Status status;
+        for (MPI_Iprobe(MPI_ANY_SOURCE, SHARED_BOUND_TAG, comm, &flag, &status); flag; MPI_Iprobe(MPI_ANY_SOURCE, SHARED_BOUND_TAG, comm, &flag, &status)) {
+            double c;
+            MPI_Recv(&c, 1, MPI_DOUBLE, status.MPI_SOURCE, SHARED_BOUND_TAG, comm, MPI_STATUS_IGNORE);
+            received++;
+            if (c < best) {
+                best = c;
+                adopted++;
+            }
+        }
+        for (auto it=outbox.begin(); it!=outbox.end(); ) {
+            MPI_Testall(it->requests.size(), it->requests.data(), &flag, MPI_STATUSES_IGNORE);
+            it = flag ? outbox.erase(it) : std::next(it);
+        }
+    }
+
+    // Collective, called once the rank has no search left
+    void finish() {
+        while (!outbox.empty()) {
+            progress();
+        }
+        MPI_Request barrier;
+        MPI_Ibarrier(comm, &barrier);
+        for (int done = 0; !done; ) {
+            progress();
+            MPI_Test(&barrier, &done, MPI_STATUS_IGNORE);
+        }
+    }
+
+    long nodes;
+    // Costs sent, received, and received ones that lowered the bound
+    long sent, received, adopted;
+
+private:
+    struct Message {
+        double cost;
+        std::vector<MPI_Request> requests;
+    };
+
+    MPI_Comm comm;
+    int rank, size;
+    long poll;
+    double best;
+    // std::list so buffers stay put while their sends are pending
+    std::list<Message> outbox;
+};
+
+#endif
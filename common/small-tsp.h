@@ -0,0 +1,151 @@
+#ifndef SMALL_TSP_H
+#define SMALL_TSP_H
+
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+/*
+Exact kernels for tiny instances (N <= 16), instantiated once per N so the
+distance matrix, the visited masks (uint16_t) and every loop bound are
+compile-time sized. Up to SMALL_DFS_MAX cities a depth-unrolled search is
+used; from N = 6 on a bitmask Held-Karp, whose thread_local table of
+2^(N-1) x (N-1) doubles grows from 2.5 KB at N = 6 to 3.75 MB at N = 16,
+so only the smaller sizes stay in cache.
+*/
+
+#define SMALL_TSP_MAX 16
+#define SMALL_DFS_MAX 5
+
+
+// One template instance per depth, the compiler flattens the whole search
+template <int N, int DEPTH>
+struct SmallDfs {
+    static void run(const double *d, uint16_t mask, int last, double cost, double &best, int *path, int *best_path) {
+        for (int i=1; i<N; i++) {
+            if (mask & (1 << i)) {
+                continue;
+            }
+            // Canonical direction: path[1] < path[N-1]
+            if (DEPTH == N - 1 && i < path[1]) {
+                continue;
+            }
+            double c = cost + d[last * N + i];
+            if (c >= best) {
+                continue;
+            }
+            path[DEPTH] = i;
+            SmallDfs<N, DEPTH + 1>::run(d, mask | (1 << i), i, c, best, path, best_path);
+        }
+    }
+};
+
+template <int N>
+struct SmallDfs<N, N> {
+    static void run(const double *d, uint16_t, int last, double cost, double &best, int *path, int *best_path) {
+        cost += d[last * N];
+        if (cost < best) {
+            best = cost;
+            std::copy(path, path + N, best_path);
+        }
+    }
+};
+
+// Held-Karp over uint16_t masks of the cities 1..N-1
+template <int N>
+double small_held_karp(const double *d, int *tour) {
+    const int n = N - 1;
+    const uint16_t full = (1 << n) - 1;
+    static thread_local double dp[1 << n][n > 0 ? n : 1];
+    for (uint16_t s=1; s<=full; s++) {
+        for (uint16_t m=s; m; m &= m - 1) {
+            int e = __builtin_ctz(m);
+            uint16_t prev = s & ~(1 << e);
+            const double *to_e = d + (e + 1);
+            if (prev == 0) {
+                dp[s][e] = to_e[0];
+                continue;
+            }
+            double best = std::numeric_limits<double>::infinity();
+            for (uint16_t p=prev; p; p &= p - 1) {
+                int j = __builtin_ctz(p);
+                best = std::min(best, dp[prev][j] + to_e[(j + 1) * N]);
+            }
+            dp[s][e] = best;
+        }
+    }
+    double best = std::numeric_limits<double>::infinity();
+    int e = 0;
+    for (int j=0; j<n; j++) {
+        double c = dp[full][j] + d[(j + 1) * N];
+        if (c < best) {
+            best = c;
+            e = j;
+        }
+    }
+    tour[0] = 0;
+    uint16_t s = full;
+    for (int k=n; k>=1; k--) {
+        tour[k] = e + 1;
+        uint16_t prev = s & ~(1 << e);
+        int arg = 0;
+        double m = std::numeric_limits<double>::infinity();
+        for (int j=0; j<n; j++) {
+            if ((prev & (1 << j)) && dp[prev][j] + d[(j + 1) * N + e + 1] < m) {
+                m = dp[prev][j] + d[(j + 1) * N + e + 1];
+                arg = j;
+            }
+        }
+        s = prev;
+        e = arg;
+    }
+    if (N > 2 && tour[1] > tour[N-1]) {
+        std::reverse(tour + 1, tour + N);
+    }
+    return best;
+}
+
+template <int N>
+double small_tsp(const double *x, const double *y, int *tour) {
+    double d[N * N];
+    for (int i=0; i<N; i++) {
+        for (int j=0; j<N; j++) {
+            d[i * N + j] = std::sqrt((x[i] - x[j]) * (x[i] - x[j]) + (y[i] - y[j]) * (y[i] - y[j]));
+        }
+    }
+    if (N <= 2) {
+        for (int i=0; i<N; i++) {
+            tour[i] = i;
+        }
+        return N == 2 ? 2 * d[1] : 0;
+    }
+    if (N <= SMALL_DFS_MAX) {
+        double best = std::numeric_limits<double>::infinity();
+        int path[N];
+        path[0] = 0;
+        SmallDfs<N, 1>::run(d, 1, 0, 0, best, path, tour);
+        return best;
+    }
+    return small_held_karp<N>(d, tour);
+}
+
+typedef double (*SmallKernel)(const double *, const double *, int *);
+
+template <int... Ns>
+struct SmallTable {
+    static SmallKernel get(int N) {
+        static const SmallKernel kernels[] = {nullptr, small_tsp<Ns>...};
+        return kernels[N];
+    }
+};
+
+// Runtime dispatch on N, returns the tour cost (infinity if N is too large)
+inline double solve_small(int N, const double *x, const double *y, int *tour) {
+    if (N < 1 || N > SMALL_TSP_MAX) {
+        return std::numeric_limits<double>::infinity();
+    }
+    return SmallTable<1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15, 16>::get(N)(x, y, tour);
+}
+
+#endif
@@ -0,0 +1,60 @@
+#ifndef STOP_TOKEN_H
+#define STOP_TOKEN_H
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+Cooperative cancellation shared by concurrent engines. Hot loops only read
+an atomic flag; an optional timer thread raises it at the deadline so no
+engine has to read the clock.
+*/
+
+
+class StopToken {
+public:
+    StopToken() : flag(false) {}
+
+    ~StopToken() {
+        request_stop();
+        if (timer.joinable()) {
+            timer.join();
+        }
+    }
+
+    // Raises the flag "seconds" from now
+    void set_deadline(double seconds) {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+        timer = std::thread([this, deadline] {
+            std::unique_lock<std::mutex> lock(mutex);
+            wake.wait_until(lock, deadline, [this] {
+                return stop_requested();
+            });
+            flag.store(true, std::memory_order_relaxed);
+        });
+    }
+
+    void request_stop() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            flag.store(true, std::memory_order_relaxed);
+        }
+        wake.notify_all();
+    }
+
+    // One relaxed load, cheap enough for every node of a search
+    bool stop_requested() const {
+        return flag.load(std::memory_order_relaxed);
+    }
+
+private:
+    std::atomic<bool> flag;
+    std::thread timer;
+    std::mutex mutex;
+    std::condition_variable wake;
+};
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SUBSET_RANK_H
+#define SUBSET_RANK_H
+
+#include <cstdint>
+#include <vector>
+
+/*
+Combinatorial number system for subsets of {0..n-1} stored as bitmasks.
+Subsets of the same size are ranked in colex order, which is the numeric
+order of the masks, so Gosper's hack walks a layer in rank order.
+*/
+
+
+struct SubsetRank {
+    SubsetRank(int n) : n(n), binom((n + 1) * (n + 1), 0) {
+        for (int i=0; i<=n; i++) {
+            binom[i * (n + 1)] = 1;
+            for (int k=1; k<=i; k++) {
+                binom[i * (n + 1) + k] = binom[(i - 1) * (n + 1) + k - 1] + (k <= i - 1 ? binom[(i - 1) * (n + 1) + k] : 0);
+            }
+        }
+    }
+
+    // C(i, k), zero when k > i
+    uint64_t choose(int i, int k) const {
+        if (k < 0 || k > i) {
+            return 0;
+        }
+        return binom[i * (n + 1) + k];
+    }
+
+    // Rank of "mask" among the subsets with the same number of elements
+    uint64_t rank(uint32_t mask) const {
+        uint64_t r = 0;
+        int k = 1;
+        for (; mask; mask &= mask - 1, k++) {
+            r += choose(__builtin_ctz(mask), k);
+        }
+        return r;
+    }
+
+    // Subset of size k with the given rank
+    uint32_t unrank(uint64_t r, int k) const {
+        uint32_t mask = 0;
+        for (int p=n-1; k>0; p--) {
+            uint64_t c = choose(p, k);
+            if (c <= r) {
+                mask |= 1u << p;
+                r -= c;
+                k--;
+            }
+        }
+        return mask;
+    }
+
+    int n;
+    std::vector<uint64_t> binom;
+};
+
+// Next larger mask with the same number of set bits (Gosper's hack)
+inline uint32_t next_subset(uint32_t mask) {
+    uint32_t c = mask & -mask;
+    uint32_t r = mask + c;
+    return (((r ^ mask) >> 2) / c) | r;
+}
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <fstream>
+#include <string>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <limits>
+
+/*
+Anytime progress log: one line per incumbent improvement with the seconds
+since start, the cost and the gap to the best known lower bound ("-" when
+the engine has none). Lines are flushed right away so a job killed at its
+deadline still leaves the full history.
+*/
+
+
+class Trace {
+public:
+    Trace() : out(nullptr), bound(-std::numeric_limits<double>::infinity()), start(std::chrono::steady_clock::now()) {}
+
+    // "-" streams to stdout, an empty path leaves the trace off. "label" is
+    // written in front of every line, e.g. the MPI rank.
+    void open(const std::string &path, const std::string &label = "") {
+        prefix = label.empty() ? "" : label + " ";
+        if (path == "-") {
+            out = &std::cout;
+        }
+        else if (!path.empty()) {
+            file.open(path);
+            out = &file;
+        }
+    }
+
+    bool enabled() const {
+        return out != nullptr;
+    }
+
+    // Raises the lower bound used for the gap
+    void set_bound(double lb) {
+        double curr = bound.load(std::memory_order_relaxed);
+        while (lb > curr && !bound.compare_exchange_weak(curr, lb)) {}
+    }
+
+    void improved(double cost) {
+        if (out == nullptr) {
+            return;
+        }
+        double t = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+        double lb = bound.load(std::memory_order_relaxed);
+        std::ostringstream line;
+        line << std::fixed << std::setprecision(5) << prefix << t << " " << cost << " ";
+        if (lb > -std::numeric_limits<double>::infinity() && cost > 0) {
+            line << std::setprecision(3) << 100 * std::max(0.0, cost - lb) / cost << "%";
+        }
+        else {
+            line << "-";
+        }
+        std::lock_guard<std::mutex> lock(mutex);
+        *out << line.str() << std::endl;
+    }
+
+    // Last line of a run, the gap is 0 when the search was completed
+    void done(double cost, bool proven) {
+        if (proven) {
+            set_bound(cost);
+        }
+        improved(cost);
+    }
+
+private:
+    std::ostream *out;
+    std::ofstream file;
+    std::string prefix;
+    std::mutex mutex;
+    std::atomic<double> bound;
+    std::chrono::steady_clock::time_point start;
+};
+
+#endif
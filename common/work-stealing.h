@@ -0,0 +1,163 @@
+#ifndef WORK_STEALING_H
+#define WORK_STEALING_H
+
+#include <atomic>
+#include <vector>
+#include <random>
+#include <iostream>
+#include <thread>
+#include <omp.h>
+
+/*
+Work-stealing scheduler for the tree searches.
+Every OpenMP thread owns a Chase-Lev deque: the owner pushes and pops
+at the bottom (deepest subtree first) while idle threads steal from the
+top, which always holds the shallowest open subtree.
+*/
+
+
+// Chase-Lev deque with a fixed power of two capacity (Le et al., PPoPP'13)
+template <typename T>
+class WorkDeque {
+public:
+    WorkDeque(long capacity = 1 << 16) : top(0), bottom(0), mask(capacity - 1), buf(capacity) {}
+
+    // Owner only. Returns false when the deque is full.
+    bool push(T *task) {
+        long b = bottom.load(std::memory_order_relaxed);
+        long t = top.load(std::memory_order_acquire);
+        if (b - t > mask) {
+            return false;
+        }
+        buf[b & mask].store(task, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        bottom.store(b + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    // Owner only, LIFO end.
+    T *pop() {
+        long b = bottom.load(std::memory_order_relaxed) - 1;
+        bottom.store(b, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long t = top.load(std::memory_order_relaxed);
+        if (t > b) {
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return nullptr;
+        }
+        T *task = buf[b & mask].load(std::memory_order_relaxed);
+        if (t == b) {
+            // Last element, race against the thieves
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                task = nullptr;
+            }
+            bottom.store(b + 1, std::memory_order_relaxed);
+        }
+        return task;
+    }
+
+    // Any thread, FIFO end.
+    T *steal() {
+        long t = top.load(std::memory_order_acquire);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        long b = bottom.load(std::memory_order_acquire);
+        if (t >= b) {
+            return nullptr;
+        }
+        T *task = buf[t & mask].load(std::memory_order_relaxed);
+        if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+            return nullptr;
+        }
+        return task;
+    }
+
+private:
+    alignas(64) std::atomic<long> top;
+    alignas(64) std::atomic<long> bottom;
+    long mask;
+    std::vector<std::atomic<T *>> buf;
+};
+
+
+struct alignas(64) WorkerStats {
+    double busy = 0;
+    double idle = 0;
+    long tasks = 0;
+    long steals = 0;
+    long steal_attempts = 0;
+};
+
+
+// Runs a root task and everything it spawns on an OpenMP team.
+// "fn(task, sched)" executes one task and may call sched.spawn() for subtrees;
+// tasks are heap allocated and deleted by the scheduler once executed.
+template <typename T>
+class WorkStealing {
+public:
+    WorkStealing(int threads = omp_get_max_threads()) : nthreads(threads), deques(threads), stats(threads), pending(0) {}
+
+    template <typename Fn>
+    void run(T *root, Fn fn) {
+        pending.store(1);
+        deques[0].push(root);
+        #pragma omp parallel num_threads(nthreads)
+        {
+            int id = omp_get_thread_num();
+            std::minstd_rand rng(id + 1);
+            WorkerStats &st = stats[id];
+            double begin = omp_get_wtime();
+            while (pending.load(std::memory_order_acquire) > 0) {
+                T *task = deques[id].pop();
+                if (task == nullptr && nthreads > 1) {
+                    int victim = rng() % (nthreads - 1);
+                    victim += (victim >= id);
+                    st.steal_attempts++;
+                    task = deques[victim].steal();
+                    if (task != nullptr) {
+                        st.steals++;
+                    }
+                }
+                if (task == nullptr) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                double t0 = omp_get_wtime();
+                fn(task, *this);
+                delete task;
+                st.busy += omp_get_wtime() - t0;
+                st.tasks++;
+                pending.fetch_sub(1, std::memory_order_acq_rel);
+            }
+            st.idle = omp_get_wtime() - begin - st.busy;
+        }
+    }
+
+    // Queues a subtree on the calling thread's deque, or runs it right away
+    // when the deque is full.
+    template <typename Fn>
+    void spawn(T *task, Fn fn) {
+        pending.fetch_add(1, std::memory_order_relaxed);
+        if (!deques[omp_get_thread_num()].push(task)) {
+            fn(task, *this);
+            delete task;
+            pending.fetch_sub(1, std::memory_order_acq_rel);
+        }
+    }
+
+    void report(std::ostream &out) {
+        out << "thread busy(s) idle(s) tasks steals/attempts" << std::endl;
+        for (int i=0; i<nthreads; i++) {
+            out << i << " " << stats[i].busy << " " << stats[i].idle << " " << stats[i].tasks
+                << " " << stats[i].steals << "/" << stats[i].steal_attempts << std::endl;
+        }
+    }
+
+    int nthreads;
+    std::vector<WorkDeque<T>> deques;
+    std::vector<WorkerStats> stats;
+
+private:
+    std::atomic<long> pending;
+};
+
+#endif
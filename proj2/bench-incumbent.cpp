@@ -0,0 +1,89 @@
+#include <iostream>
+#include <vector>
+#include <omp.h>
+#include <limits>
+#include <iomanip>
+#include <random>
+#include <string>
+
+#include "incumbent.h"
+
+/*
+Contention microbenchmark: every thread offers tours to a shared incumbent,
+once through "#pragma omp critical" and once through the lock-free Incumbent.
+How to compile and run:
+g++ -O3 -fopenmp -I../common bench-incumbent.cpp && OMP_NUM_THREADS=8 ./a.out 13 1000000
+*/
+
+
+// Cost of the k-th offer of a thread. "improving" makes every offer beat the
+// previous ones so all threads fight for the incumbent, otherwise costs are
+// random and most offers are rejected by the pruning read.
+double offer_cost(bool improving, long k, int tid, int threads, std::minstd_rand &rng) {
+    if (improving) {
+        return 1e12 - double(k * threads + tid);
+    }
+    return 1e6 + rng();
+}
+
+double run_critical(bool improving, int N, long offers) {
+    double best_cost = std::numeric_limits<double>::infinity();
+    std::vector<int> best_sol(N, -1);
+    double start = omp_get_wtime();
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        std::minstd_rand rng(tid + 1);
+        std::vector<int> tour(N, tid);
+        for (long k=0; k<offers; k++) {
+            double c = offer_cost(improving, k, tid, threads, rng);
+            if (c < best_cost) {
+                #pragma omp critical
+                {
+                    if (c < best_cost) {
+                        best_cost = c;
+                        best_sol = tour;
+                    }
+                }
+            }
+        }
+    }
+    return omp_get_wtime() - start;
+}
+
+double run_lock_free(bool improving, int N, long offers) {
+    Incumbent best(N);
+    double start = omp_get_wtime();
+    #pragma omp parallel
+    {
+        int tid = omp_get_thread_num();
+        int threads = omp_get_num_threads();
+        std::minstd_rand rng(tid + 1);
+        std::vector<int> tour(N, tid);
+        for (long k=0; k<offers; k++) {
+            double c = offer_cost(improving, k, tid, threads, rng);
+            if (c < best.cost()) {
+                best.offer(c, tour);
+            }
+        }
+    }
+    return omp_get_wtime() - start;
+}
+
+int main(int argc, char *argv[]) {
+    int N = argc > 1 ? std::stoi(argv[1]) : 13;
+    long offers = argc > 2 ? std::stol(argv[2]) : 1000000;
+    int threads = omp_get_max_threads();
+    std::cout << std::fixed << std::setprecision(2);
+    std::cout << "threads " << threads << " cities " << N << " offers/thread " << offers << std::endl;
+    for (int improving=0; improving<2; improving++) {
+        double crit = run_critical(improving, N, offers);
+        double lock_free = run_lock_free(improving, N, offers);
+        double total = double(offers) * threads;
+        std::cout << (improving ? "improving" : "random   ")
+                  << "  critical " << 1e9 * crit / total << " ns/offer"
+                  << "  lock-free " << 1e9 * lock_free / total << " ns/offer" << std::endl;
+    }
+    return 0;
+}
@@ -10,10 +10,36 @@
 // For writing into file
 #include <fstream>
 #include <string>
+// Best-first frontier
+#include <queue>
+#include <cstdint>
+#include <algorithm>
+
+#include "branch-bound.h"
+#include "local-search.h"
+#include "stop-token.h"
+#include "trace.h"
+#include "checkpoint.h"
 
 /*
 How to compile and run:
-clear && g++ tsp-par1.cpp -fopenmp && echo 10 | python3 generator.py | ./a.out
+clear && g++ tsp-bb.cpp -I../common -fopenmp && echo 10 | python3 generator.py | ./a.out
+Best-first mode (frontier capped at 64 MB before falling back to depth-first dives):
+./a.out --best-first --mem-cap 64 < inputs/in10
+Subtrees with at most GRAIN cities left are not split further (default 7):
+./a.out --grain 5 < inputs/in12
+Children are explored nearest city first, "--bound-order" sorts them by lower bound
+and "--index-order" keeps the plain 1..N-1 order for comparison:
+./a.out --bound-order < inputs/in12
+"--prep" enforces convex hull order and drops edges that cannot be optimal:
+./a.out --prep < inputs/in12
+"--time-limit SEC" stops at the deadline with the best tour so far (printed with
+0 instead of 1), "--trace FILE" logs every improvement and its gap to the lower
+bound ("-" for stdout):
+./a.out --best-first --time-limit 5 --trace - < inputs/in12
+"--checkpoint FILE" saves the unfinished subtrees and the incumbent every
+"--checkpoint-every SEC" seconds (default 60), "--resume" restarts from FILE:
+./a.out --checkpoint /scratch/bb.ckpt --resume < inputs/in16
 */
 
 
@@ -30,54 +56,266 @@ double path_dist(std::vector<int> sol, std::vector<std::vector<double>> points)
 }
 
 
-void branch_n_bound(std::vector<std::vector<double>> points, int idx, double curr_cost, double &best_cost, std::vector<int> curr_sol, std::vector<bool> used, std::vector<int> &best_sol, int start = 0) {
-    if (curr_cost > best_cost) {
+std::vector<double> dist_matrix(std::vector<std::vector<double>> &points) {
+    int N = points.size();
+    std::vector<double> d(N * N);
+    for (int i=0; i<N; i++) {
+        for (int j=0; j<N; j++) {
+            d[i * N + j] = dist(points[i], points[j]);
+        }
+    }
+    return d;
+}
+
+// Frontier node of the best-first search. The path is not stored, it is
+// recovered by following "parent" through the arena.
+struct Node {
+    double cost;
+    uint32_t visited;
+    int32_t parent;
+    int16_t city;
+    int16_t depth;
+};
+
+struct BestFirstStats {
+    long expansions = 0;
+    long dives = 0;
+    size_t peak_bytes = 0;
+};
+
+void report_gap(BestFirstStats &stats, size_t open, double lb, double best_cost) {
+    std::cerr << "expanded " << stats.expansions << " open " << open << " lb " << lb << " ub " << best_cost;
+    if (best_cost < std::numeric_limits<double>::infinity()) {
+        std::cerr << " gap " << 100 * (best_cost - lb) / best_cost << "%";
+    }
+    std::cerr << std::endl;
+}
+
+// Best-first branch and bound: always expands the open node with the smallest
+// lower bound. Once the arena plus the heap exceed "mem_cap" bytes, popped nodes
+// are solved with a depth-first dive instead of being expanded into the frontier.
+void best_first(BnBData &data, Incumbent &best, size_t mem_cap, DepthStats &depth_stats, Trace &trace) {
+    int N = data.N;
+    typedef std::pair<double, int32_t> Entry;
+    std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> frontier;
+    std::vector<Node> arena;
+    BestFirstStats stats;
+    std::vector<int> curr_sol(N, -1);
+    curr_sol[0] = 0;
+    if (N == 1) {
+        best.offer(0, curr_sol);
         return;
     }
-    if (idx == points.size()) {
-        curr_cost += dist(points[curr_sol[0]], points[curr_sol[curr_sol.size()-1]]);
-        if (curr_cost >= best_cost){}
+    HullState root_hull = data.prep ? data.prep->hull_start() : HullState{};
+
+    arena.push_back({0, 1u, -1, 0, 1});
+    frontier.push({lower_bound(data.d, N, 0, 1u, 0), 0});
+    double lb = frontier.top().first;
+    while (!frontier.empty()) {
+        if (data.stop && data.stop->stop_requested()) {
+            break;
+        }
+        Entry top = frontier.top();
+        frontier.pop();
+        lb = top.first;
+        if (lb >= best.cost()) {
+            lb = best.cost();
+            break;
+        }
+        // Every open node is at least as expensive, so this is a global bound
+        trace.set_bound(lb);
+        Node node = arena[top.second];
+        size_t bytes = arena.capacity() * sizeof(Node) + frontier.size() * sizeof(Entry);
+        stats.peak_bytes = std::max(stats.peak_bytes, bytes);
+        uint64_t prev_epoch = best.epoch();
+        // The hull state is not stored in the arena, it is replayed from the path
+        HullState hull = root_hull;
+        if (data.prep || bytes > mem_cap) {
+            for (int32_t n=top.second; n>=0; n=arena[n].parent) {
+                curr_sol[arena[n].depth-1] = arena[n].city;
+            }
+            for (int k=1; data.prep && k<node.depth; k++) {
+                data.prep->hull_step(hull, curr_sol[k]);
+            }
+        }
+        if (bytes > mem_cap) {
+            // Frontier is full: finish this node depth-first
+            branch_n_bound(data, node.depth, node.visited, node.cost, hull, best, curr_sol, depth_stats);
+            stats.dives++;
+        }
         else {
-            #pragma omp critical
-            {
-                if (curr_cost >= best_cost) {
-                }
-                else {
-                    best_cost = curr_cost;
-                    best_sol = curr_sol;
+            stats.expansions++;
+            Child children[32];
+            int n = order_children(data, node.depth, node.city, node.visited, node.cost, hull, best, children, depth_stats);
+            for (int k=0; k<n; k++) {
+                int i = children[k].city;
+                uint32_t mask = node.visited | (1u << i);
+                double cost = children[k].cost;
+                double bound = children[k].bound;
+                if (node.depth + 1 == N) {
+                    // Leaf: the bound is the closed tour cost
+                    curr_sol[N-1] = i;
+                    for (int32_t n=top.second; n>=0; n=arena[n].parent) {
+                        curr_sol[arena[n].depth-1] = arena[n].city;
+                    }
+                    best.offer(bound, curr_sol);
+                    continue;
                 }
+                arena.push_back({cost, mask, top.second, (int16_t)i, (int16_t)(node.depth + 1)});
+                frontier.push({bound, (int32_t)arena.size() - 1});
             }
         }
+        if (best.epoch() != prev_epoch) {
+            report_gap(stats, frontier.size(), lb, best.cost());
+        }
+    }
+    if (frontier.empty()) {
+        lb = best.cost();
+    }
+    report_gap(stats, frontier.size(), lb, best.cost());
+    std::cerr << "dives " << stats.dives << " peak frontier " << stats.peak_bytes / 1024 << " KB" << std::endl;
+}
+
+// Cities on the path of each checkpointed subtree, city 0 included
+#define CHECKPOINT_DEPTH 4
+
+// Every path from city 0 with "len" cities
+void open_prefixes(int N, int len, std::vector<int32_t> &path, std::vector<std::vector<int32_t>> &out) {
+    if (path.size() == len) {
+        out.push_back(path);
         return;
     }
-    int max_iter = points.size();
-    if (start) {
-        max_iter = start + 1;
+    for (int i=1; i<N; i++) {
+        if (std::find(path.begin(), path.end(), i) == path.end()) {
+            path.push_back(i);
+            open_prefixes(N, len, path, out);
+            path.pop_back();
+        }
     }
-    for (int i=start; i<max_iter; i++) {
-        if (!used[i]) {
-            used[i] = true;
-            curr_sol[idx] = i;
-            double new_cost = curr_cost + dist(points[curr_sol[idx-1]], points[curr_sol[idx]]);
-            branch_n_bound(points, idx+1, new_cost, best_cost, curr_sol, used, best_sol);
+}
 
-            used[i] = false;
-            curr_sol[idx] = -1;
+void save_units(const std::string &path, int N, uint64_t instance, Incumbent &best, std::vector<std::vector<int32_t>> &units, std::vector<std::atomic<char>> &done) {
+    Checkpoint cp;
+    cp.N = N;
+    cp.engine = CHECKPOINT_BB;
+    cp.instance = instance;
+    // Units before the incumbent: a tour found in a unit marked done is then
+    // always saved with it
+    for (size_t u=0; u<units.size(); u++) {
+        if (!done[u].load()) {
+            cp.prefixes.push_back(units[u]);
         }
     }
-    return;
+    cp.best_cost = best.cost();
+    for (int c : best.tour()) {
+        cp.best_tour.push_back(c);
+    }
+    if (!save_checkpoint(path, cp)) {
+        std::cerr << "Could not write checkpoint " << path << std::endl;
+    }
 }
 
-int main() {
+// Depth-first search over a fixed list of subtrees so progress can be saved:
+// the checkpoint lists the subtrees not finished yet, those in progress are
+// redone after a restart. Returns the number of subtrees left.
+size_t checkpointed(BnBData &data, Incumbent &best, std::vector<std::vector<int32_t>> &units, const std::string &path, CheckpointTimer &timer, std::vector<DepthStats> &stats) {
+    int N = data.N;
+    uint64_t instance = instance_fingerprint(data.d.data(), N);
+    std::vector<std::atomic<char>> done(units.size());
+    #pragma omp parallel for schedule(dynamic, 1)
+    for (size_t u=0; u<units.size(); u++) {
+        std::vector<int> sol(N, -1);
+        uint32_t mask = 0;
+        double cost = 0;
+        HullState hull = data.prep ? data.prep->hull_start() : HullState{};
+        bool valid = true;
+        for (size_t k=0; k<units[u].size(); k++) {
+            sol[k] = units[u][k];
+            mask |= 1u << sol[k];
+            if (k > 0) {
+                cost += data.d[sol[k-1] * N + sol[k]];
+                valid = valid && (!data.prep || (data.prep->edge(sol[k-1], sol[k]) && data.prep->hull_step(hull, sol[k])));
+            }
+        }
+        if (valid && lower_bound(data.d, N, sol[units[u].size()-1], mask, cost) < best.cost()) {
+            branch_n_bound(data, units[u].size(), mask, cost, hull, best, sol, stats[omp_get_thread_num()]);
+        }
+        if (!(data.stop && data.stop->stop_requested())) {
+            done[u].store(1);
+        }
+        if (timer.due()) {
+            save_units(path, N, instance, best, units, done);
+            timer.saved();
+        }
+    }
+    save_units(path, N, instance, best, units, done);
+    size_t left = 0;
+    for (auto &d : done) {
+        left += !d.load();
+    }
+    return left;
+}
+
+int main(int argc, char *argv[]) {
+    bool best_first_mode = false;
+    bool bound_order = false;
+    bool index_order = false;
+    bool prep_mode = false;
+    double time_limit = 0;
+    std::string trace_path;
+    std::string checkpoint_path;
+    double checkpoint_every = 60;
+    bool resume = false;
+    size_t mem_cap = 256;
+    int grain = 7;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--best-first") {
+            best_first_mode = true;
+        }
+        else if (arg == "--mem-cap" && i+1 < argc) {
+            mem_cap = std::stoul(argv[++i]);
+        }
+        else if (arg == "--bound-order") {
+            bound_order = true;
+        }
+        else if (arg == "--index-order") {
+            index_order = true;
+        }
+        else if (arg == "--prep") {
+            prep_mode = true;
+        }
+        else if (arg == "--time-limit" && i+1 < argc) {
+            time_limit = std::stod(argv[++i]);
+        }
+        else if (arg == "--trace" && i+1 < argc) {
+            trace_path = argv[++i];
+        }
+        else if (arg == "--grain" && i+1 < argc) {
+            grain = std::stoi(argv[++i]);
+        }
+        else if (arg == "--checkpoint" && i+1 < argc) {
+            checkpoint_path = argv[++i];
+        }
+        else if (arg == "--checkpoint-every" && i+1 < argc) {
+            checkpoint_every = std::stod(argv[++i]);
+        }
+        else if (arg == "--resume") {
+            resume = true;
+        }
+    }
     // Setting print decimal precision
     std::cout << std::fixed << std::setprecision(5);
     // Number of points
     int N;
     std::cin >> N;
+    if (N > 32) {
+        std::cerr << "At most 32 cities are supported" << std::endl;
+        return 1;
+    }
     std::vector<std::vector<double>> points;
     // Positions os the points
     double x, y;
-    std::vector<int> best_sol(N, -1);
     for (int i=0; i<N; i++) {
         // Filling "points" vector
         std::vector<double> temp;
@@ -87,28 +325,70 @@ int main() {
         temp.push_back(y);
         points.push_back(temp);
     }
-    double best_cost = std::numeric_limits<double>::infinity();
+    Incumbent best(N);
+    StopToken stop;
+    Trace trace;
+    trace.open(trace_path);
+    best.on_improve([&](double c) {
+        trace.improved(c);
+    });
+    WorkStealing<Prefix> sched;
+    std::vector<DepthStats> depth_stats(sched.nthreads, DepthStats{std::vector<long>(N + 1), std::vector<long>(N + 1)});
     auto start = std::chrono::high_resolution_clock::now();
-    #pragma omp parallel
-    {
-        #pragma omp master
-        {
-            for (int i=1; i<N; i++) {
-                #pragma omp task shared(best_sol, best_cost)
-                {
-                    std::vector<bool> used(N, false);
-                    used[0] = true;
-                    std::vector<int> curr_sol(N, -1);
-                    curr_sol[0] = 0;
-                    branch_n_bound(points, 1, 0, best_cost, curr_sol, used, best_sol, i);
-                }
+    auto data = make_data(dist_matrix(points), N, bound_order, index_order);
+    Preprocess prep;
+    if (prep_mode) {
+        prep = preprocess(points, data.d);
+        data.prep = &prep;
+    }
+    data.stop = &stop;
+    if (N > 0) {
+        trace.set_bound(lower_bound(data.d, N, 0, 1u, 0));
+    }
+    if (time_limit > 0) {
+        seed_anytime(best, data.d.data(), N);
+        stop.set_deadline(time_limit);
+    }
+    CheckpointTimer timer(checkpoint_every);
+    if (best_first_mode) {
+        best_first(data, best, mem_cap << 20, depth_stats[0], trace);
+    }
+    else if (!checkpoint_path.empty() && N > CHECKPOINT_DEPTH) {
+        std::vector<std::vector<int32_t>> units;
+        Checkpoint cp;
+        bool loaded = resume && load_checkpoint(checkpoint_path, cp);
+        if (loaded && (cp.N != N || cp.engine != CHECKPOINT_BB || cp.instance != instance_fingerprint(data.d.data(), N))) {
+            std::cerr << "checkpoint " << checkpoint_path << " is from another search or instance, starting over" << std::endl;
+            loaded = false;
+        }
+        if (loaded) {
+            if (cp.best_tour.size() == size_t(N)) {
+                best.offer(cp.best_cost, std::vector<int>(cp.best_tour.begin(), cp.best_tour.end()));
             }
+            units = cp.prefixes;
+            std::cerr << "resumed with " << units.size() << " subtrees left" << std::endl;
+        }
+        else {
+            std::vector<int32_t> root(1, 0);
+            open_prefixes(N, CHECKPOINT_DEPTH, root, units);
         }
+        size_t left = checkpointed(data, best, units, checkpoint_path, timer, depth_stats);
+        std::cerr << "checkpoints " << timer.saves << " took " << timer.spent << " s, " << left << " subtrees left" << std::endl;
     }
+    else {
+        std::vector<int> root_sol(N, -1);
+        root_sol[0] = 0;
+        ParallelBnB search{data, grain, best, depth_stats};
+        HullState root_hull = prep_mode ? prep.hull_start() : HullState{};
+        sched.run(new Prefix{1, 1u, 0, lower_bound(data.d, N, 0, 1u, 0), root_hull, root_sol}, search);
+    }
+    bool completed = !stop.stop_requested();
     auto finish = std::chrono::high_resolution_clock::now();
     auto time_span = (std::chrono::duration_cast<std::chrono::duration<double>>(finish-start)).count();
 
-    std::cout << path_dist(best_sol, points) << " 1" << std::endl;
+    auto best_sol = best.tour();
+    trace.done(path_dist(best_sol, points), completed);
+    std::cout << path_dist(best_sol, points) << " " << completed << std::endl;
     for (int i=0; i<best_sol.size(); i++) {
         std::cout << best_sol[i];
         if (i < best_sol.size()-1) {
@@ -116,6 +396,13 @@ int main() {
         }
     }
     std::cout << std::endl;
+    if (prep_mode) {
+        prep.report(std::cerr);
+    }
+    report_depths(depth_stats, N);
+    if (!best_first_mode && checkpoint_path.empty()) {
+        sched.report(std::cerr);
+    }
     std::cerr << time_span << std::endl;
     return 0;
 }
\ No newline at end of file
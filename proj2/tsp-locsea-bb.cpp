@@ -14,9 +14,22 @@
 #include <algorithm>
 #include <random>
 
+#include "local-search.h"
+#include "branch-bound.h"
+#include "stop-token.h"
+#include "trace.h"
+#include "philox.h"
+
 /*
 How to compile and run:
-clear && g++ tsp-par1.cpp -fopenmp && echo 10 | python3 generator.py | ./a.out
+clear && g++ tsp-locsea-bb.cpp -I../common -fopenmp && echo 10 | python3 generator.py | ./a.out
+The heuristic phase stops after SEC seconds (default 1) or once it stops improving:
+./a.out --warm-time 0.2 < inputs/in12
+"--time-limit SEC" stops both stages at the deadline with the best tour so far
+(printed with 0 instead of 1), "--trace FILE" logs every improvement ("-" for stdout):
+./a.out --time-limit 5 --trace - < inputs/in12
+"--deterministic" hands ties to the lexicographically smallest canonical tour,
+so runs without a time limit print the same bytes for any number of threads.
 */
 
 
@@ -32,120 +45,68 @@ double path_dist(std::vector<int> sol, std::vector<std::vector<double>> points)
     return d;
 }
 
-double path_dist_loc(std::vector<std::vector<double>> points) {
-    double d = dist(points[points.size()-1], points[0]);
-    for (int i=0; i<points.size()-1; i++) {
-        d += dist(points[i], points[i+1]);
+std::vector<double> dist_matrix(std::vector<std::vector<double>> &points) {
+    int N = points.size();
+    std::vector<double> d(N * N);
+    for (int i=0; i<N; i++) {
+        for (int j=0; j<N; j++) {
+            d[i * N + j] = dist(points[i], points[j]);
+        }
     }
     return d;
 }
 
-
-// https://stackoverflow.com/a/14177062/9785530
-bool check_intersec(std::vector<double> p1, std::vector<double> p2, std::vector<double> q1, std::vector<double> q2) {
-    return (((q1[0]-p1[0])*(p2[1]-p1[1]) - (q1[1]-p1[1])*(p2[0]-p1[0]))
-            * ((q2[0]-p1[0])*(p2[1]-p1[1]) - (q2[1]-p1[1])*(p2[0]-p1[0])) < 0)
-            &&
-           (((p1[0]-q1[0])*(q2[1]-q1[1]) - (p1[1]-q1[1])*(q2[0]-q1[0]))
-            * ((p2[0]-q1[0])*(q2[1]-q1[1]) - (p2[1]-q1[1])*(q2[0]-q1[0])) < 0);
-}
-
-void local_search(std::vector<std::vector<double>> points, double &best_cost) {
-    bool flag = true;
-    while (flag) {
-        for (int i=0; i<points.size()-1; i++) {
-            for (int j=i+1; j<points.size(); j++) {
-                if (j == points.size() - 1) {
-                    if (check_intersec(points[i], points[i+1], points[j], points[0])) {
-                        auto temp = points[i+1];
-                        points[i+1] = points[j];
-                        points[j] = temp;
-                        flag = true;
-                    }
-                    else {
-                        flag = false;
-                    }
-                }
-                else {
-                    if (check_intersec(points[i], points[i+1], points[j], points[j+1])) {
-                        auto temp = points[i+1];
-                        points[i+1] = points[j];
-                        points[j] = temp;
-                        flag = true;
-                    }
-                    else {
-                        flag = false;
-                    }
-                }
-            }
-        }
-    }
-    auto curr_cost = path_dist_loc(points);
-    if (curr_cost > best_cost) {}
-    else {
-        #pragma omp critical
-        {
-            if (curr_cost < best_cost) {
-                best_cost = curr_cost;
-            }
+// Heuristic phase: every thread runs an iterated local search, thread 0 from
+// the nearest neighbour tour and the others from random tours.
+void warm_start(std::vector<double> &d, int N, double seconds, Incumbent &best, StopToken &stop) {
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+    #pragma omp parallel
+    {
+        Philox rng(0, omp_get_thread_num());
+        std::vector<int> tour = nearest_neighbour(d, N);
+        if (omp_get_thread_num() > 0) {
+            philox_shuffle(tour.begin(), tour.end(), rng);
         }
+        iterated_local_search(d, N, tour, deadline, 50 * N, rng, best, &stop);
     }
-    return;
 }
 
-
-
-void branch_n_bound(std::vector<std::vector<double>> points, int idx, double curr_cost, double &best_cost, std::vector<int> curr_sol, std::vector<bool> used, std::vector<int> &best_sol, int start = 0) {
-    if (curr_cost > best_cost) {
-        return;
-    }
-    if (idx == points.size()) {
-        curr_cost += dist(points[curr_sol[0]], points[curr_sol[curr_sol.size()-1]]);
-        if (curr_cost > best_cost){}
-        else {
-            #pragma omp critical
-            {
-                if (curr_cost > best_cost) {
-                }
-                else {
-                    best_cost = curr_cost;
-                    best_sol = curr_sol;
-                }
-            }
+int main(int argc, char *argv[]) {
+    double warm_time = 1;
+    int grain = 7;
+    double time_limit = 0;
+    std::string trace_path;
+    bool deterministic = false;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--warm-time" && i+1 < argc) {
+            warm_time = std::stod(argv[++i]);
         }
-        return;
-    }
-    int max_iter = points.size();
-    if (start) {
-        max_iter = start + 1;
-    }
-    for (int i=start; i<max_iter; i++) {
-        if (!used[i]) {
-            used[i] = true;
-            curr_sol[idx] = i;
-            double new_cost = curr_cost + dist(points[curr_sol[idx-1]], points[curr_sol[idx]]);
-            branch_n_bound(points, idx+1, new_cost, best_cost, curr_sol, used, best_sol);
-
-            used[i] = false;
-            curr_sol[idx] = -1;
+        else if (arg == "--grain" && i+1 < argc) {
+            grain = std::stoi(argv[++i]);
+        }
+        else if (arg == "--time-limit" && i+1 < argc) {
+            time_limit = std::stod(argv[++i]);
+        }
+        else if (arg == "--trace" && i+1 < argc) {
+            trace_path = argv[++i];
+        }
+        else if (arg == "--deterministic") {
+            deterministic = true;
         }
     }
-    return;
-}
-
-int main() {
     // Setting print decimal precision
     std::cout << std::fixed << std::setprecision(5);
     // Number of points
     int N;
     std::cin >> N;
-    // Points vector for branch and bound
+    if (N > 32) {
+        std::cerr << "At most 32 cities are supported" << std::endl;
+        return 1;
+    }
     std::vector<std::vector<double>> points;
-    // Points vector for local search
-    std::vector<std::vector<double>> points_loc;
     // Positions os the points
     double x, y;
-    std::vector<int> best_sol(N, -1);
     for (int i=0; i<N; i++) {
         // Filling "points" vector
         std::vector<double> temp;
@@ -154,41 +115,49 @@ int main() {
         temp.push_back(x);
         temp.push_back(y);
         points.push_back(temp);
-        temp.push_back(i);
-        points_loc.push_back(temp);
     }
-    double best_cost = std::numeric_limits<double>::infinity();
+    Incumbent best(N);
+    StopToken stop;
+    Trace trace;
+    trace.open(trace_path);
+    best.on_improve([&](double c) {
+        trace.improved(c);
+    });
+    if (time_limit > 0) {
+        stop.set_deadline(time_limit);
+    }
+    WorkStealing<Prefix> sched;
+    std::vector<DepthStats> depth_stats(sched.nthreads, DepthStats{std::vector<long>(N + 1), std::vector<long>(N + 1)});
     auto start = std::chrono::high_resolution_clock::now();
-    #pragma omp parallel
-    {
-        #pragma omp master
-        {
-            for (int i=1; i<200; i++) {
-                auto rng = std::default_random_engine {};
-                #pragma omp task shared(best_cost)
-                {
-                    auto tempvec = points_loc;
-                    std::random_shuffle(std::begin(tempvec), std::end(tempvec));
-                    local_search(tempvec, best_cost);
-                }
-            }
-
-            for (int i=1; i<N; i++) {
-                #pragma omp task shared(best_sol, best_cost)
-                {
-                    std::vector<bool> used(N, false);
-                    used[0] = true;
-                    std::vector<int> curr_sol(N, -1);
-                    curr_sol[0] = 0;
-                    branch_n_bound(points, 1, 0, best_cost, curr_sol, used, best_sol, i);
-                }
-            }
-        }
+    auto data = make_data(dist_matrix(points), N, false, false);
+    data.stop = &stop;
+    if (deterministic) {
+        best.deterministic([&](const int *tour) {
+            return path_length(data.d.data(), N, tour);
+        });
     }
+    if (N > 0) {
+        trace.set_bound(lower_bound(data.d, N, 0, 1u, 0));
+    }
+    warm_start(data.d, N, warm_time, best, stop);
+    double warm_cost = best.cost();
+    uint64_t warm_epoch = best.epoch();
+    auto warm = std::chrono::high_resolution_clock::now();
+
+    // B&B only accepts strictly better tours (or, deterministic, lexicographically
+    // smaller ties), the warm tour stands otherwise
+    std::vector<int> root_sol(N, -1);
+    root_sol[0] = 0;
+    hint_order(data, best.tour());
+    ParallelBnB search{data, grain, best, depth_stats};
+    sched.run(new Prefix{1, 1u, 0, lower_bound(data.d, N, 0, 1u, 0), HullState{}, root_sol}, search);
+    bool completed = !stop.stop_requested();
     auto finish = std::chrono::high_resolution_clock::now();
     auto time_span = (std::chrono::duration_cast<std::chrono::duration<double>>(finish-start)).count();
 
-    std::cout << path_dist(best_sol, points) << " 1" << std::endl;
+    auto best_sol = best.tour();
+    trace.done(path_dist(best_sol, points), completed);
+    std::cout << path_dist(best_sol, points) << " " << completed << std::endl;
     for (int i=0; i<best_sol.size(); i++) {
         std::cout << best_sol[i];
         if (i < best_sol.size()-1) {
@@ -197,6 +166,17 @@ int main() {
     }
     std::cout << std::endl;
 
+    std::cerr << "warm start " << warm_cost << " in " << std::chrono::duration<double>(warm - start).count() << " s, ";
+    // Ties that differ only by summation order do not count as improvements
+    bool kept = best.epoch() == warm_epoch || best.cost() > warm_cost * (1 - 1e-9);
+    if (kept) {
+        std::cerr << (completed ? "proven optimal by B&B" : "not improved before the deadline") << std::endl;
+    }
+    else {
+        std::cerr << "improved by B&B to " << best.cost() << std::endl;
+    }
+    report_depths(depth_stats, N);
+    sched.report(std::cerr);
     std::cerr << time_span << std::endl;
     return 0;
 }
\ No newline at end of file
@@ -14,9 +14,21 @@
 #include <algorithm>
 #include <random>
 
+#include "incumbent.h"
+#include "stop-token.h"
+#include "trace.h"
+#include "philox.h"
+
 /*
 How to compile and run:
-clear && g++ tsp-locsea.cpp -fopenmp && echo 10 | python3 generator.py | ./a.out
+clear && g++ tsp-locsea.cpp -I../common -fopenmp && echo 10 | python3 generator.py | ./a.out
+"--time-limit SEC" keeps restarting until the deadline instead of doing 10000
+restarts, "--trace FILE" logs every improvement ("-" for stdout):
+./a.out --time-limit 5 --trace - < inputs/in12
+Restart i shuffles with its own Philox stream (seed, i), "--seed S" (default 0)
+picks another set of starting tours; the same for any number of threads.
+"--deterministic" hands ties to the lexicographically smallest canonical tour,
+so runs without a time limit print the same bytes for any number of threads.
 */
 
 
@@ -41,7 +53,7 @@ bool check_intersec(std::vector<double> p1, std::vector<double> p2, std::vector<
             * ((p2[0]-q1[0])*(q2[1]-q1[1]) - (p2[1]-q1[1])*(q2[0]-q1[0])) < 0);
 }
 
-void local_search(std::vector<std::vector<double>> points, double &best_cost, std::vector<std::vector<double>> &best_sol) {
+void local_search(std::vector<std::vector<double>> points, Incumbent &best) {
     bool flag = true;
     while (flag) {
         for (int i=0; i<points.size()-1; i++) {
@@ -72,20 +84,36 @@ void local_search(std::vector<std::vector<double>> points, double &best_cost, st
         }
     }
     auto curr_cost = path_dist(points);
-    if (curr_cost > best_cost) {}
-    else {
-        #pragma omp critical
-        {
-            if (curr_cost < best_cost) {
-                best_cost = curr_cost;
-                best_sol = points;
-            }
+    if (curr_cost < best.cutoff()) {
+        std::vector<int> tour(points.size());
+        for (int i=0; i<points.size(); i++) {
+            tour[i] = int(points[i][2]);
         }
+        best.offer(curr_cost, tour);
     }
     return;
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    double time_limit = 0;
+    std::string trace_path;
+    uint64_t seed = 0;
+    bool deterministic = false;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--time-limit" && i+1 < argc) {
+            time_limit = std::stod(argv[++i]);
+        }
+        else if (arg == "--trace" && i+1 < argc) {
+            trace_path = argv[++i];
+        }
+        else if (arg == "--seed" && i+1 < argc) {
+            seed = std::stoull(argv[++i]);
+        }
+        else if (arg == "--deterministic") {
+            deterministic = true;
+        }
+    }
     // Setting print decimal precision
     std::cout << std::fixed << std::setprecision(5);
     // Number of points
@@ -104,21 +132,41 @@ int main() {
         temp.push_back(i);
         points.push_back(temp);
     }
-    auto best_sol = points;
-    double best_cost = std::numeric_limits<double>::infinity();
+    Incumbent best(N);
+    StopToken stop;
+    Trace trace;
+    trace.open(trace_path);
+    best.on_improve([&](double c) {
+        trace.improved(c);
+    });
+    if (deterministic) {
+        best.deterministic([&](const int *tour) {
+            std::vector<std::vector<double>> path;
+            for (int i=0; i<N; i++) {
+                path.push_back(points[tour[i]]);
+            }
+            return path_dist(path);
+        });
+    }
     auto start = std::chrono::high_resolution_clock::now();
+    if (time_limit > 0) {
+        stop.set_deadline(time_limit);
+    }
 
     #pragma omp parallel
     {
         #pragma omp master
         {
-            for (int i=1; i<10000; i++) {
-                auto rng = std::default_random_engine {};
-                #pragma omp task shared(best_cost, best_sol)
+            for (long i=1; time_limit > 0 ? !stop.stop_requested() : i < 10000; i++) {
+                #pragma omp task shared(best, stop)
                 {
-                    auto tempvec = points;
-                    std::random_shuffle(std::begin(tempvec), std::end(tempvec));
-                    local_search(tempvec, best_cost, best_sol);
+                    // The first restart always runs so there is a tour to print
+                    if (i == 1 || !stop.stop_requested()) {
+                        auto tempvec = points;
+                        Philox rng(seed, i);
+                        philox_shuffle(tempvec.begin(), tempvec.end(), rng);
+                        local_search(tempvec, best);
+                    }
                 }
             }
         }
@@ -126,6 +174,11 @@ int main() {
     auto finish = std::chrono::high_resolution_clock::now();
     auto time_span = (std::chrono::duration_cast<std::chrono::duration<double>>(finish-start)).count();
 
+    std::vector<std::vector<double>> best_sol;
+    for (int i : best.tour()) {
+        best_sol.push_back(points[i]);
+    }
+    trace.done(path_dist(best_sol), false);
     std::cout << path_dist(best_sol) << " 0" << std::endl;
     for (int i=0; i<best_sol.size(); i++) {
         std::cout << int(best_sol[i][2]);
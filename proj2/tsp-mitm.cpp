@@ -0,0 +1,151 @@
+#include <iostream>
+#include <math.h>
+#include <vector>
+#include <omp.h>
+#include <chrono>
+// For infinite
+#include <limits>
+// For output decimal numbers
+#include <iomanip>
+#include <string>
+
+#include "meet-middle.h"
+#include "local-search.h"
+#include "stop-token.h"
+#include "trace.h"
+
+/*
+How to compile and run:
+clear && g++ tsp-mitm.cpp -I../common -fopenmp && echo 22 | python3 generator.py | ./a.out
+DP costs are doubles, "--float" halves the memory but the tour is then printed
+with 0, since rounding can pick a tour slightly longer than the optimum.
+When the half table (about 60% of the full one) is larger than "--mem-cap MB"
+(default: physical memory) it is backed by files under "--mmap DIR" (default
+/tmp) and only about two layers, a third of the full table, stay resident:
+./a.out --mem-cap 512 --mmap /scratch < input
+"--time-limit SEC" gives up at the deadline and prints a local search tour (with 0
+instead of 1), "--trace FILE" logs the tours found ("-" for stdout):
+./a.out --time-limit 5 --trace - < inputs/in12
+*/
+
+
+double dist(std::vector<double> p1, std::vector<double> p2) {
+    return sqrt(pow((p1[0] - p2[0]), 2) + pow((p1[1] - p2[1]), 2));
+}
+
+double path_dist(std::vector<int> sol, std::vector<std::vector<double>> points) {
+    double d = dist(points[sol[sol.size()-1]], points[sol[0]]);
+    for (int i=0; i<sol.size()-1; i++) {
+        d += dist(points[sol[i]], points[sol[i+1]]);
+    }
+    return d;
+}
+
+std::vector<double> dist_matrix(std::vector<std::vector<double>> &points) {
+    int N = points.size();
+    std::vector<double> d(N * N);
+    for (int i=0; i<N; i++) {
+        for (int j=0; j<N; j++) {
+            d[i * N + j] = dist(points[i], points[j]);
+        }
+    }
+    return d;
+}
+
+int main(int argc, char *argv[]) {
+    bool use_double = true;
+    double time_limit = 0;
+    std::string trace_path;
+    std::string mmap_dir = "/tmp";
+    size_t mem_cap = size_t(sysconf(_SC_PHYS_PAGES)) * sysconf(_SC_PAGE_SIZE);
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--float") {
+            use_double = false;
+        }
+        else if (arg == "--mmap" && i+1 < argc) {
+            mmap_dir = argv[++i];
+        }
+        else if (arg == "--time-limit" && i+1 < argc) {
+            time_limit = std::stod(argv[++i]);
+        }
+        else if (arg == "--trace" && i+1 < argc) {
+            trace_path = argv[++i];
+        }
+        else if (arg == "--mem-cap" && i+1 < argc) {
+            mem_cap = std::stoul(argv[++i]) << 20;
+        }
+    }
+    // Setting print decimal precision
+    std::cout << std::fixed << std::setprecision(5);
+    // Number of points
+    int N;
+    std::cin >> N;
+    if (N > 32) {
+        std::cerr << "At most 32 cities are supported" << std::endl;
+        return 1;
+    }
+    std::vector<std::vector<double>> points;
+    // Positions os the points
+    double x, y;
+    for (int i=0; i<N; i++) {
+        // Filling "points" vector
+        std::vector<double> temp;
+        std::cin >> x;
+        std::cin >> y;
+        temp.push_back(x);
+        temp.push_back(y);
+        points.push_back(temp);
+    }
+    size_t bytes = meet_middle_bytes(N, use_double ? sizeof(double) : sizeof(float));
+    if (bytes <= mem_cap) {
+        mmap_dir = "";
+    }
+    std::cerr << "Half DP table " << bytes / (1 << 20) << " MB (full table " << held_karp_bytes(N, use_double ? sizeof(double) : sizeof(float)) / (1 << 20) << " MB)"
+              << (mmap_dir.empty() ? "" : " mapped under " + mmap_dir) << std::endl;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    auto d = dist_matrix(points);
+    StopToken stop;
+    Trace trace;
+    trace.open(trace_path);
+    // The table only yields a tour at the very end, so anytime mode keeps a
+    // local search tour to fall back on at the deadline
+    std::vector<int> fallback;
+    if (time_limit > 0 && N > 0) {
+        fallback = nearest_neighbour(d, N);
+        trace.improved(descend(d, N, fallback));
+        stop.set_deadline(time_limit);
+    }
+    std::vector<int> best_sol;
+    double best_cost;
+    if (use_double) {
+        best_cost = meet_middle<double>(d, N, best_sol, mmap_dir, &stop);
+    }
+    else {
+        best_cost = meet_middle<float>(d, N, best_sol, mmap_dir, &stop);
+    }
+    bool completed = !stop.stop_requested();
+    auto finish = std::chrono::high_resolution_clock::now();
+    auto time_span = (std::chrono::duration_cast<std::chrono::duration<double>>(finish-start)).count();
+    if (best_cost == std::numeric_limits<double>::infinity()) {
+        if (completed || fallback.empty()) {
+            return 1;
+        }
+        best_sol = fallback;
+    }
+    // Float costs only prove the tour optimal up to rounding
+    completed = completed && use_double;
+
+    trace.done(path_dist(best_sol, points), completed);
+    std::cout << path_dist(best_sol, points) << " " << completed << std::endl;
+    for (int i=0; i<best_sol.size(); i++) {
+        std::cout << best_sol[i];
+        if (i < best_sol.size()-1) {
+            std::cout << " ";
+        }
+    }
+    std::cout << std::endl;
+    std::cerr << time_span << std::endl;
+    return 0;
+}
@@ -10,10 +10,31 @@
 // For writing into file
 #include <fstream>
 #include <string>
+#include <cstdint>
+
+#include "work-stealing.h"
+#include "incumbent.h"
+#include "perm-rank.h"
+#include "plain-changes.h"
+#include "local-search.h"
+#include "stop-token.h"
+#include "trace.h"
 
 /*
 How to compile and run:
-clear && g++ tsp-par1.cpp -fopenmp && echo 10 | python3 generator.py | ./a.out
+clear && g++ tsp-par1.cpp -I../common -fopenmp && echo 10 | python3 generator.py | ./a.out
+Subtrees with at most GRAIN cities left are not split further (default 7):
+./a.out --grain 5 < inputs/in11
+"--chunks K" instead cuts the ranked tour space into K equal ranges:
+./a.out --chunks 256 < inputs/in11
+"--incremental" gives each thread whole (second, last) city pairs enumerated
+with one adjacent swap per tour:
+./a.out --incremental < inputs/in12
+"--time-limit SEC" stops at the deadline with the best tour so far (printed with
+0 instead of 1), "--trace FILE" logs every improvement ("-" for stdout):
+./a.out --time-limit 5 --trace - < inputs/in12
+"--deterministic" hands ties to the lexicographically smallest canonical tour,
+so runs without a time limit print the same bytes for any number of threads.
 */
 
 
@@ -29,53 +50,134 @@ double path_dist(std::vector<int> sol, std::vector<std::vector<double>> points)
     return d;
 }
 
-void backtrack(std::vector<std::vector<double>> points, int idx, double curr_cost, double &best_cost, std::vector<int> curr_sol, std::vector<bool> used, std::vector<int> &best_sol, int start = 0) {
-    if (idx == points.size()) {
-        curr_cost += dist(points[curr_sol[0]], points[curr_sol[curr_sol.size()-1]]);
-        if (curr_cost >= best_cost){}
-        else {
-            #pragma omp critical
-            {
-                if (curr_cost >= best_cost) {
-                }
-                else {
-                    best_cost = curr_cost;
-                    best_sol = curr_sol;
-                }
-                // else {}
-                // std::cout << "best: " << best_cost << std::endl;
-            }
+std::vector<double> dist_matrix(std::vector<std::vector<double>> &points) {
+    int N = points.size();
+    std::vector<double> d(N * N);
+    for (int i=0; i<N; i++) {
+        for (int j=0; j<N; j++) {
+            d[i * N + j] = dist(points[i], points[j]);
         }
+    }
+    return d;
+}
+
+// A tour and its reverse have the same cost, so only tours with
+// sol[1] < sol[N-1] are enumerated: placing "i" at "idx" has to leave a city
+// greater than sol[1] for the last position.
+bool canonical(int N, int idx, int i, uint32_t mask, std::vector<int> &sol) {
+    if (N < 3) {
+        return true;
+    }
+    if (idx == 1) {
+        return i < N-1;
+    }
+    if (idx == N-1) {
+        return i > sol[1];
+    }
+    uint32_t full = (N == 32) ? 0xffffffffu : ((1u << N) - 1);
+    uint32_t above = full & ~(mask | (1u << i)) & ~((2u << sol[1]) - 1);
+    return above != 0;
+}
+
+void backtrack(std::vector<double> &d, int N, int idx, uint32_t mask, double curr_cost, Incumbent &best, std::vector<int> &curr_sol, StopToken *stop = nullptr) {
+    int last = curr_sol[idx-1];
+    if (stop && stop->stop_requested()) {
         return;
     }
-    int max_iter = points.size();
-    if (start) {
-        max_iter = start + 1;
+    if (idx == N) {
+        curr_cost += d[last * N + curr_sol[0]];
+        if (curr_cost < best.cutoff()) {
+            best.offer(curr_cost, curr_sol);
+        }
+        return;
     }
-    for (int i=start; i<max_iter; i++) {
-        if (!used[i]) {
-            used[i] = true;
+    for (int i=1; i<N; i++) {
+        if (!(mask & (1u << i)) && canonical(N, idx, i, mask, curr_sol)) {
             curr_sol[idx] = i;
-            double new_cost = curr_cost + dist(points[curr_sol[idx-1]], points[curr_sol[idx]]);
-            backtrack(points, idx+1, new_cost, best_cost, curr_sol, used, best_sol);
-
-            used[i] = false;
+            backtrack(d, N, idx+1, mask | (1u << i), curr_cost + d[last * N + i], best, curr_sol, stop);
             curr_sol[idx] = -1;
         }
     }
     return;
 }
 
-int main() {
+// Open subtree handed to the work-stealing scheduler
+struct Prefix {
+    int idx;
+    uint32_t mask;
+    double cost;
+    std::vector<int> sol;
+};
+
+// Splits prefixes into child tasks until only "grain" cities are left to
+// place, then enumerates the subtree sequentially.
+struct ParallelEnum {
+    std::vector<double> &d;
+    int N;
+    int grain;
+    Incumbent &best;
+    StopToken *stop;
+
+    void operator()(Prefix *p, WorkStealing<Prefix> &sched) {
+        if (stop->stop_requested()) {
+            return;
+        }
+        if (N - p->idx <= grain) {
+            backtrack(d, N, p->idx, p->mask, p->cost, best, p->sol, stop);
+            return;
+        }
+        int last = p->sol[p->idx-1];
+        // Pushed in reverse so the owner pops the lowest index first
+        for (int i=N-1; i>=1; i--) {
+            if (!(p->mask & (1u << i)) && canonical(N, p->idx, i, p->mask, p->sol)) {
+                Prefix *child = new Prefix{p->idx + 1, p->mask | (1u << i), p->cost + d[last * N + i], p->sol};
+                child->sol[p->idx] = i;
+                sched.spawn(child, *this);
+            }
+        }
+    }
+};
+
+int main(int argc, char *argv[]) {
+    int grain = 7;
+    long chunks = 0;
+    bool incremental = false;
+    double time_limit = 0;
+    std::string trace_path;
+    bool deterministic = false;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--grain" && i+1 < argc) {
+            grain = std::stoi(argv[++i]);
+        }
+        else if (arg == "--chunks" && i+1 < argc) {
+            chunks = std::stol(argv[++i]);
+        }
+        else if (arg == "--incremental") {
+            incremental = true;
+        }
+        else if (arg == "--time-limit" && i+1 < argc) {
+            time_limit = std::stod(argv[++i]);
+        }
+        else if (arg == "--trace" && i+1 < argc) {
+            trace_path = argv[++i];
+        }
+        else if (arg == "--deterministic") {
+            deterministic = true;
+        }
+    }
     // Setting print decimal precision
     std::cout << std::fixed << std::setprecision(5);
     // Number of points
     int N;
     std::cin >> N;
+    if (N > 32) {
+        std::cerr << "At most 32 cities are supported" << std::endl;
+        return 1;
+    }
     std::vector<std::vector<double>> points;
     // Positions os the points
     double x, y;
-    std::vector<int> best_sol(N, -1);
     for (int i=0; i<N; i++) {
         // Filling "points" vector
         std::vector<double> temp;
@@ -85,28 +187,65 @@ int main() {
         temp.push_back(y);
         points.push_back(temp);
     }
-    double best_cost = std::numeric_limits<double>::infinity();
+    Incumbent best(N);
+    WorkStealing<Prefix> sched;
+    StopToken stop;
+    Trace trace;
+    trace.open(trace_path);
+    best.on_improve([&](double c) {
+        trace.improved(c);
+    });
     auto start = std::chrono::high_resolution_clock::now();
-    #pragma omp parallel
-    {
-        #pragma omp master
-        {
-            for (int i=1; i<N; i++) {
-                #pragma omp task shared(best_sol, best_cost)
-                {
-                    std::vector<bool> used(N, false);
-                    used[0] = true;
-                    std::vector<int> curr_sol(N, -1);
-                    curr_sol[0] = 0;
-                    backtrack(points, 1, 0, best_cost, curr_sol, used, best_sol, i);
-                }
+    auto d = dist_matrix(points);
+    if (deterministic) {
+        best.deterministic([&](const int *tour) {
+            return path_length(d.data(), N, tour);
+        });
+    }
+    if (time_limit > 0) {
+        seed_anytime(best, d.data(), N);
+        stop.set_deadline(time_limit);
+    }
+    if (incremental && N >= 3) {
+        std::vector<std::pair<int, int>> pairs;
+        for (int a=1; a<N; a++) {
+            for (int c=a+1; c<N; c++) {
+                pairs.push_back({a, c});
+            }
+        }
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (size_t p=0; p<pairs.size(); p++) {
+            double pair_cost = std::numeric_limits<double>::infinity();
+            std::vector<int> pair_sol;
+            enumerate_pair(d, N, pairs[p].first, pairs[p].second, pair_cost, pair_sol, &stop);
+            best.offer(pair_cost, pair_sol);
+        }
+    }
+    else if (chunks > 0 && N >= 3 && N <= 21) {
+        TourSpace space(N);
+        #pragma omp parallel for schedule(dynamic, 1)
+        for (long c=0; c<chunks; c++) {
+            double chunk_cost = std::numeric_limits<double>::infinity();
+            std::vector<int> chunk_sol;
+            enumerate_range(d, N, range_begin(space.size, chunks, c), range_begin(space.size, chunks, c + 1), chunk_cost, chunk_sol, &stop, deterministic);
+            if (!chunk_sol.empty()) {
+                best.offer(chunk_cost, chunk_sol);
             }
         }
     }
+    else {
+        std::vector<int> root_sol(N, -1);
+        root_sol[0] = 0;
+        ParallelEnum search{d, N, grain, best, &stop};
+        sched.run(new Prefix{1, 1u, 0, root_sol}, search);
+    }
+    bool completed = !stop.stop_requested();
     auto finish = std::chrono::high_resolution_clock::now();
     auto time_span = (std::chrono::duration_cast<std::chrono::duration<double>>(finish-start)).count();
 
-    std::cout << path_dist(best_sol, points) << " 1" << std::endl;
+    auto best_sol = best.tour();
+    trace.done(path_dist(best_sol, points), completed);
+    std::cout << path_dist(best_sol, points) << " " << completed << std::endl;
     for (int i=0; i<best_sol.size(); i++) {
         std::cout << best_sol[i];
         if (i < best_sol.size()-1) {
@@ -115,6 +254,9 @@ int main() {
     }
     std::cout << std::endl;
 
+    if (chunks == 0 && !incremental) {
+        sched.report(std::cerr);
+    }
     std::cerr << time_span << std::endl;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,266 @@
+#include <iostream>
+#include <math.h>
+#include <vector>
+#include <omp.h>
+#include <chrono>
+// For infinite
+#include <limits>
+// For output decimal numbers
+#include <iomanip>
+#include <string>
+#include <atomic>
+#include <random>
+
+#include "stop-token.h"
+#include "local-search.h"
+#include "branch-bound.h"
+#include "held-karp.h"
+#include "plain-changes.h"
+#include "trace.h"
+#include "philox.h"
+
+/*
+How to compile and run:
+clear && g++ tsp-portfolio.cpp -I../common -fopenmp && echo 10 | python3 generator.py | ./a.out
+Runs local search, branch and bound, Held-Karp and brute force side by side on
+OMP_NUM_THREADS threads, sharing one incumbent. The first exact engine to finish
+cancels the others; "--time-limit SEC" cancels everything at the deadline and the
+best tour found so far is printed (with 0 instead of 1 since it is not proven):
+OMP_NUM_THREADS=4 ./a.out --time-limit 10 < inputs/in12
+"--trace FILE" logs every improvement ("-" for stdout):
+./a.out --trace - < inputs/in12
+Held-Karp only runs when its table fits in "--mem-cap MB" (default 1024) and brute
+force only up to 13 cities.
+*/
+
+
+double dist(std::vector<double> p1, std::vector<double> p2) {
+    return sqrt(pow((p1[0] - p2[0]), 2) + pow((p1[1] - p2[1]), 2));
+}
+
+double path_dist(std::vector<int> sol, std::vector<std::vector<double>> points) {
+    double d = dist(points[sol[sol.size()-1]], points[sol[0]]);
+    for (int i=0; i<sol.size()-1; i++) {
+        d += dist(points[sol[i]], points[sol[i+1]]);
+    }
+    return d;
+}
+
+std::vector<double> dist_matrix(std::vector<std::vector<double>> &points) {
+    int N = points.size();
+    std::vector<double> d(N * N);
+    for (int i=0; i<N; i++) {
+        for (int j=0; j<N; j++) {
+            d[i * N + j] = dist(points[i], points[j]);
+        }
+    }
+    return d;
+}
+
+enum Engine { LOCAL_SEARCH, BRANCH_BOUND, HELD_KARP, BRUTE_FORCE, ENGINES };
+const char *engine_names[ENGINES] = {"locsea", "bb", "hk", "seq"};
+
+// State shared by the engines of one run
+struct Portfolio {
+    std::vector<double> &d;
+    int N;
+    Incumbent &best;
+    StopToken &stop;
+    bool has_deadline;
+    // Exact engines still running, local search keeps restarting until they end
+    std::atomic<int> exact_running;
+    // First exact engine to finish, -1 while nothing is proven
+    std::atomic<int> proven_by;
+    double finished[ENGINES];
+
+    // Called by an exact engine that ran to completion
+    void prove(int engine) {
+        int none = -1;
+        if (proven_by.compare_exchange_strong(none, engine)) {
+            stop.request_stop();
+        }
+    }
+};
+
+// Restarts an iterated local search from random tours on every thread
+void run_local_search(Portfolio &pf, int threads) {
+    #pragma omp parallel num_threads(threads)
+    {
+        Philox rng(0, omp_get_thread_num());
+        std::vector<int> tour = nearest_neighbour(pf.d, pf.N);
+        bool first = omp_get_thread_num() == 0;
+        do {
+            if (!first) {
+                philox_shuffle(tour.begin(), tour.end(), rng);
+            }
+            first = false;
+            iterated_local_search(pf.d, pf.N, tour, std::chrono::steady_clock::time_point::max(), 50 * pf.N, rng, pf.best, &pf.stop);
+        } while (!pf.stop.stop_requested() && (pf.exact_running.load() > 0 || pf.has_deadline));
+    }
+}
+
+// Depth-first B&B, proves optimality of the incumbent when it completes
+bool run_branch_bound(Portfolio &pf, int threads) {
+    int N = pf.N;
+    auto data = make_data(pf.d, N, false, false);
+    data.stop = &pf.stop;
+    WorkStealing<Prefix> sched(threads);
+    std::vector<DepthStats> depth_stats(threads, DepthStats{std::vector<long>(N + 1), std::vector<long>(N + 1)});
+    std::vector<int> root_sol(N, -1);
+    root_sol[0] = 0;
+    ParallelBnB search{data, 7, pf.best, depth_stats};
+    sched.run(new Prefix{1, 1u, 0, lower_bound(data.d, N, 0, 1u, 0), HullState{}, root_sol}, search);
+    return !pf.stop.stop_requested();
+}
+
+bool run_held_karp(Portfolio &pf, int threads) {
+    omp_set_num_threads(threads);
+    std::vector<int> tour;
+    double cost = held_karp<double>(pf.d, pf.N, tour, "", &pf.stop);
+    if (cost == std::numeric_limits<double>::infinity()) {
+        return false;
+    }
+    pf.best.offer(tour_cost(pf.d, pf.N, tour), tour);
+    return true;
+}
+
+// Plain changes over every (tour[1], tour[N-1]) pair
+bool run_brute_force(Portfolio &pf, int threads) {
+    int N = pf.N;
+    #pragma omp parallel for schedule(dynamic) num_threads(threads)
+    for (int p=0; p<(N-1)*(N-1); p++) {
+        int a = p / (N - 1) + 1, c = p % (N - 1) + 1;
+        if (a >= c || pf.stop.stop_requested()) {
+            continue;
+        }
+        double cost = std::numeric_limits<double>::infinity();
+        std::vector<int> tour;
+        enumerate_pair(pf.d, N, a, c, cost, tour, &pf.stop);
+        if (!tour.empty()) {
+            pf.best.offer(cost, tour);
+        }
+    }
+    return !pf.stop.stop_requested();
+}
+
+int main(int argc, char *argv[]) {
+    double time_limit = 0;
+    size_t mem_cap = 1024;
+    std::string trace_path;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--time-limit" && i+1 < argc) {
+            time_limit = std::stod(argv[++i]);
+        }
+        else if (arg == "--mem-cap" && i+1 < argc) {
+            mem_cap = std::stoul(argv[++i]);
+        }
+        else if (arg == "--trace" && i+1 < argc) {
+            trace_path = argv[++i];
+        }
+    }
+    // Setting print decimal precision
+    std::cout << std::fixed << std::setprecision(5);
+    // Number of points
+    int N;
+    std::cin >> N;
+    std::vector<std::vector<double>> points;
+    // Positions os the points
+    double x, y;
+    for (int i=0; i<N; i++) {
+        // Filling "points" vector
+        std::vector<double> temp;
+        std::cin >> x;
+        std::cin >> y;
+        temp.push_back(x);
+        temp.push_back(y);
+        points.push_back(temp);
+    }
+    auto d = dist_matrix(points);
+    Incumbent best(N);
+    Trace trace;
+    trace.open(trace_path);
+    best.on_improve([&](double c) {
+        trace.improved(c);
+    });
+    if (N > 0 && N <= 32) {
+        trace.set_bound(lower_bound(d, N, 0, 1u, 0));
+    }
+    StopToken stop;
+    if (time_limit > 0) {
+        stop.set_deadline(time_limit);
+    }
+    Portfolio pf{d, N, best, stop, time_limit > 0, {0}, {-1}, {}};
+
+    // Engines that can finish on this instance
+    bool enabled[ENGINES] = {true, N <= 32, N <= 32 && held_karp_bytes(N, sizeof(double)) <= (mem_cap << 20), N >= 3 && N <= 13};
+    int engines = 0;
+    for (int e=0; e<ENGINES; e++) {
+        engines += enabled[e];
+        pf.finished[e] = -1;
+    }
+    pf.exact_running = engines - 1;
+    // Even split of the thread budget, the remainder goes to B&B
+    int budget = omp_get_max_threads();
+    int threads[ENGINES];
+    for (int e=0; e<ENGINES; e++) {
+        threads[e] = std::max(1, budget / engines);
+    }
+    threads[BRANCH_BOUND] += std::max(0, budget - threads[0] * engines);
+
+    auto start = std::chrono::high_resolution_clock::now();
+    omp_set_max_active_levels(2);
+    #pragma omp parallel num_threads(ENGINES)
+    {
+        int e = omp_get_thread_num();
+        if (enabled[e]) {
+            bool proved = false;
+            if (e == LOCAL_SEARCH) {
+                run_local_search(pf, threads[e]);
+            }
+            else if (e == BRANCH_BOUND) {
+                proved = run_branch_bound(pf, threads[e]);
+            }
+            else if (e == HELD_KARP) {
+                proved = run_held_karp(pf, threads[e]);
+            }
+            else {
+                proved = run_brute_force(pf, threads[e]);
+            }
+            if (proved) {
+                pf.prove(e);
+            }
+            if (e != LOCAL_SEARCH) {
+                pf.exact_running--;
+            }
+            pf.finished[e] = (std::chrono::duration_cast<std::chrono::duration<double>>(std::chrono::high_resolution_clock::now() - start)).count();
+        }
+    }
+    auto finish = std::chrono::high_resolution_clock::now();
+    auto time_span = (std::chrono::duration_cast<std::chrono::duration<double>>(finish-start)).count();
+
+    auto best_sol = best.tour();
+    bool proven = pf.proven_by.load() >= 0;
+    trace.done(path_dist(best_sol, points), proven);
+    std::cout << path_dist(best_sol, points) << " " << proven << std::endl;
+    for (int i=0; i<best_sol.size(); i++) {
+        std::cout << best_sol[i];
+        if (i < best_sol.size()-1) {
+            std::cout << " ";
+        }
+    }
+    std::cout << std::endl;
+
+    std::cerr << "engine threads finished(s)" << std::endl;
+    for (int e=0; e<ENGINES; e++) {
+        std::cerr << engine_names[e] << " ";
+        if (enabled[e]) {
+            std::cerr << threads[e] << " " << pf.finished[e] << (pf.proven_by.load() == e ? " proved" : "") << std::endl;
+        }
+        else {
+            std::cerr << "off" << std::endl;
+        }
+    }
+    std::cerr << time_span << std::endl;
+    return 0;
+}
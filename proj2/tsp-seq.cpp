@@ -8,10 +8,24 @@
 #include <fstream>
 #include <string>
 
+#include "plain-changes.h"
+#include "preprocess.h"
+#include "local-search.h"
+#include "stop-token.h"
+#include "trace.h"
+
 
 /*
 How to compile and run:
-clear && g++ tsp-seq.cpp && echo 10 | python3 generator.py | ./a.out
+clear && g++ tsp-seq.cpp -I../common -fopenmp-simd && echo 10 | python3 generator.py | ./a.out
+"--incremental" enumerates without recursion, one adjacent swap per tour:
+./a.out --incremental < inputs/in12
+"--prep" skips tours that break convex hull order or use an eliminated edge
+(recursive mode only):
+./a.out --prep < inputs/in12
+"--time-limit SEC" stops at the deadline with the best tour so far (printed with
+0 instead of 1), "--trace FILE" logs every improvement ("-" for stdout):
+./a.out --time-limit 5 --trace - < inputs/in12
 */
 
 double dist(std::vector<double> p1, std::vector<double> p2) {
@@ -26,21 +40,55 @@ double path_dist(std::vector<int> sol, std::vector<std::vector<double>> points)
     return d;
 }
 
-double backtrack(std::vector<std::vector<double>> points, int idx, double curr_cost, double best_cost, std::vector<int> curr_sol, std::vector<bool> used, std::vector<int> &best_sol) {
-    if (idx == points.size()) {
+// A tour and its reverse have the same cost, so only tours with
+// curr_sol[1] < curr_sol[N-1] are enumerated. "above" counts the unused
+// cities greater than curr_sol[1], one of them has to be left for the end.
+// With "prep" the hull order and the allowed edges are enforced as well.
+long tours_visited = 0;
+StopToken stop;
+Trace trace;
+
+double backtrack(std::vector<std::vector<double>> points, int idx, double curr_cost, double best_cost, std::vector<int> curr_sol, std::vector<bool> used, std::vector<int> &best_sol, int above = 0, const Preprocess *prep = nullptr, HullState hull = {}) {
+    int N = points.size();
+    if (stop.stop_requested()) {
+        return best_cost;
+    }
+    if (idx == N) {
+        tours_visited++;
         curr_cost += dist(points[curr_sol[0]], points[curr_sol[curr_sol.size()-1]]);
         if (curr_cost < best_cost) {
             best_sol = curr_sol;
             best_cost = curr_cost;
+            trace.improved(best_cost);
         }
         return best_cost;
     }
-    for (int i=0; i<points.size(); i++) {
+    for (int i=0; i<N; i++) {
         if (!used[i]) {
+            int next_above = above;
+            if (idx == 1) {
+                next_above = N - 1 - i;
+                if (N > 2 && next_above == 0) {
+                    continue;
+                }
+            }
+            else if (i > curr_sol[1]) {
+                next_above--;
+                if (idx < N-1 && next_above == 0) {
+                    continue;
+                }
+            }
+            else if (idx == N-1) {
+                continue;
+            }
+            HullState next_hull = hull;
+            if (prep && (!prep->edge(curr_sol[idx-1], i) || (idx == N-1 && !prep->edge(i, 0)) || !prep->hull_step(next_hull, i))) {
+                continue;
+            }
             used[i] = true;
             curr_sol[idx] = i;
             double new_cost = curr_cost + dist(points[curr_sol[idx-1]], points[curr_sol[idx]]);
-            best_cost = backtrack(points, idx+1, new_cost, best_cost, curr_sol, used, best_sol);
+            best_cost = backtrack(points, idx+1, new_cost, best_cost, curr_sol, used, best_sol, next_above, prep, next_hull);
 
             used[i] = false;
             curr_sol[idx] = -1;
@@ -49,7 +97,35 @@ double backtrack(std::vector<std::vector<double>> points, int idx, double curr_c
     return best_cost;
 }
 
-int main() {
+std::vector<double> dist_matrix(std::vector<std::vector<double>> &points) {
+    int N = points.size();
+    std::vector<double> d(N * N);
+    for (int i=0; i<N; i++) {
+        for (int j=0; j<N; j++) {
+            d[i * N + j] = dist(points[i], points[j]);
+        }
+    }
+    return d;
+}
+
+int main(int argc, char *argv[]) {
+    bool incremental = false;
+    bool prep_mode = false;
+    double time_limit = 0;
+    for (int i=1; i<argc; i++) {
+        if (std::string(argv[i]) == "--incremental") {
+            incremental = true;
+        }
+        else if (std::string(argv[i]) == "--prep") {
+            prep_mode = true;
+        }
+        else if (std::string(argv[i]) == "--time-limit" && i+1 < argc) {
+            time_limit = std::stod(argv[++i]);
+        }
+        else if (std::string(argv[i]) == "--trace" && i+1 < argc) {
+            trace.open(argv[++i]);
+        }
+    }
     // Setting print decimal precision
     std::cout << std::fixed << std::setprecision(5);
     // Number of points
@@ -78,12 +154,39 @@ int main() {
     }
     curr_sol[0] = 0;
     used[0] = true;
+    Preprocess prep;
     auto start = std::chrono::high_resolution_clock::now();
-    backtrack(points, 1, 0, std::numeric_limits<double>::infinity(), curr_sol, used, best_sol);
+    double best_cost = std::numeric_limits<double>::infinity();
+    if (time_limit > 0) {
+        best_sol = anytime_tour(dist_matrix(points).data(), N, best_cost);
+        trace.improved(best_cost);
+        stop.set_deadline(time_limit);
+    }
+    if (incremental && N >= 3) {
+        auto d = dist_matrix(points);
+        for (int a=1; a<N; a++) {
+            for (int c=a+1; c<N; c++) {
+                double before = best_cost;
+                enumerate_pair(d, N, a, c, best_cost, best_sol, &stop);
+                if (best_cost < before) {
+                    trace.improved(best_cost);
+                }
+            }
+        }
+    }
+    else if (prep_mode) {
+        prep = preprocess(points, dist_matrix(points));
+        best_cost = backtrack(points, 1, 0, best_cost, curr_sol, used, best_sol, 0, &prep, prep.hull_start());
+    }
+    else {
+        best_cost = backtrack(points, 1, 0, best_cost, curr_sol, used, best_sol);
+    }
+    bool completed = !stop.stop_requested();
     auto finish = std::chrono::high_resolution_clock::now();
     auto time_span = (std::chrono::duration_cast<std::chrono::duration<double>>(finish-start)).count();
 
-    std::cout << path_dist(best_sol, points) << " 1" << std::endl;
+    trace.done(path_dist(best_sol, points), completed);
+    std::cout << path_dist(best_sol, points) << " " << completed << std::endl;
     for (int i=0; i<best_sol.size(); i++) {
         std::cout << best_sol[i];
         if (i < best_sol.size()-1) {
@@ -91,6 +194,18 @@ int main() {
         }
     }
     std::cout << std::endl;
+    // Both modes visit the (N-1)!/2 canonical tours
+    double tours = 1;
+    for (int i=3; i<N; i++) {
+        tours *= i;
+    }
+    if (completed) {
+        std::cerr << tours / time_span << " tours/s" << std::endl;
+    }
+    if (prep_mode && !incremental) {
+        prep.report(std::cerr);
+        std::cerr << "tours visited " << tours_visited << " of " << tours << std::endl;
+    }
     std::cerr << time_span << std::endl;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include <iostream>
+#include <math.h>
+#include <vector>
+#include <omp.h>
+#include <chrono>
+// For output decimal numbers
+#include <iomanip>
+// For reading instances line by line
+#include <sstream>
+#include <string>
+
+#include "small-tsp.h"
+
+/*
+Batch solver for instances of at most 16 cities. Reads any number of
+instances (each one "N" followed by N points) until the end of the input,
+solves them in parallel and prints the results in input order.
+How to compile and run:
+clear && g++ tsp-small.cpp -I../common -O3 -fopenmp && cat inputs/in1* | ./a.out
+*/
+
+
+int main() {
+    // Setting print decimal precision
+    std::cout << std::fixed << std::setprecision(5);
+    std::vector<int> sizes;
+    std::vector<size_t> offsets;
+    std::vector<double> xs, ys;
+    std::string line;
+    while (std::getline(std::cin, line)) {
+        // Only the first number of the header line is the number of points
+        std::istringstream header(line);
+        int N;
+        if (!(header >> N)) {
+            continue;
+        }
+        if (N > SMALL_TSP_MAX) {
+            std::cerr << "Instance " << sizes.size() << " has more than " << SMALL_TSP_MAX << " cities" << std::endl;
+            return 1;
+        }
+        sizes.push_back(N);
+        offsets.push_back(xs.size());
+        // Positions os the points
+        double x, y;
+        for (int i=0; i<N; i++) {
+            std::cin >> x >> y;
+            xs.push_back(x);
+            ys.push_back(y);
+        }
+        std::getline(std::cin, line);
+    }
+    std::vector<double> costs(sizes.size());
+    std::vector<int> tours(xs.size());
+
+    auto start = std::chrono::high_resolution_clock::now();
+    #pragma omp parallel for schedule(dynamic, 64)
+    for (size_t k=0; k<sizes.size(); k++) {
+        size_t off = offsets[k];
+        costs[k] = solve_small(sizes[k], &xs[off], &ys[off], &tours[off]);
+    }
+    auto finish = std::chrono::high_resolution_clock::now();
+    auto time_span = (std::chrono::duration_cast<std::chrono::duration<double>>(finish-start)).count();
+
+    for (size_t k=0; k<sizes.size(); k++) {
+        std::cout << costs[k] << " 1" << std::endl;
+        for (int i=0; i<sizes[k]; i++) {
+            std::cout << tours[offsets[k] + i];
+            if (i < sizes[k]-1) {
+                std::cout << " ";
+            }
+        }
+        std::cout << std::endl;
+    }
+    std::cerr << sizes.size() / time_span << " instances/s" << std::endl;
+    std::cerr << time_span << std::endl;
+    return 0;
+}
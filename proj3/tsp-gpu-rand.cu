@@ -3,10 +3,21 @@
 #include <thrust/host_vector.h>
 #include <stdio.h>
 #include <math.h>
+#include <string>
+#include <chrono>
+#include <vector>
 
 #include "curand.h"
 #include "curand_kernel.h"
 
+#include "trace.h"
+
+/*
+"--time-limit SEC" keeps launching batches of ITER random tours with new seeds
+until the deadline, "--trace FILE" logs every improvement ("-" for stdout):
+./a.out --time-limit 5 --trace - < inputs/in12
+*/
+
 #define ITER 10000
 
 
@@ -17,12 +28,14 @@ __global__ void calc_dists(double *xpos, double *ypos, double *dists, int N) {
     dists[i * N + j] = sqrt(pow((xpos[i] - xpos[j]), 2) + pow((ypos[i] - ypos[j]), 2));
 }
 
-__global__ void calc_path_dists(int *all_paths, double* path_dists, double *dists, int N) {
+__global__ void calc_path_dists(int *all_paths, double* path_dists, double *dists, int N, unsigned long long seed) {
     int t_i = blockIdx.x * blockDim.x + threadIdx.x;
     if (t_i >= N * ITER) return;
 
-    curandState st;
-    curand_init(0, t_i, 0, &st);
+    // Counter-based like common/philox.h: tour t_i of a batch is the same on
+    // any launch shape and its state is set up without XORWOW's skip-ahead
+    curandStatePhilox4_32_10_t st;
+    curand_init(seed, t_i, 0, &st);
     for (int i=0; i<N; i++) {
         all_paths[(t_i * N) + i] = i;
     }
@@ -44,7 +57,18 @@ __global__ void calc_path_dists(int *all_paths, double* path_dists, double *dist
 
 }
 
-int main() {
+int main(int argc, char *argv[]) {
+    double time_limit = 0;
+    Trace trace;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--time-limit" && i+1 < argc) {
+            time_limit = std::stod(argv[++i]);
+        }
+        else if (arg == "--trace" && i+1 < argc) {
+            trace.open(argv[++i]);
+        }
+    }
     int N;
     std::cin >> N;
     //long steps = 5000;
@@ -87,23 +111,33 @@ int main() {
                                   thrust::raw_pointer_cast(ypos_d.data()),
                                   thrust::raw_pointer_cast(dists_d.data()),
                                   N);
-    calc_path_dists<<<ceil(ITER/1024.0), 1024>>>(thrust::raw_pointer_cast(all_paths_d.data()),
-                                 thrust::raw_pointer_cast(path_dists_d.data()),
-                                 thrust::raw_pointer_cast(dists_d.data()),
-                                    N);
+    // One batch without a time limit, otherwise one batch per seed until the deadline
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(time_limit));
+    double min_val = INFINITY;
+    std::vector<int> best_path(N);
+    for (unsigned long long seed=0; seed==0 || std::chrono::steady_clock::now() < deadline; seed++) {
+        calc_path_dists<<<ceil(ITER/1024.0), 1024>>>(thrust::raw_pointer_cast(all_paths_d.data()),
+                                     thrust::raw_pointer_cast(path_dists_d.data()),
+                                     thrust::raw_pointer_cast(dists_d.data()),
+                                        N, seed);
+        thrust::device_vector<double>::iterator min = thrust::min_element(path_dists_d.begin(), path_dists_d.end());
+        int min_idx = min - path_dists_d.begin();
+        if (*min < min_val) {
+            min_val = *min;
+            thrust::copy(all_paths_d.begin() + min_idx * N, all_paths_d.begin() + (min_idx + 1) * N, best_path.begin());
+            trace.improved(min_val);
+        }
+    }
     cudaEventRecord(stop, NULL);
     cudaEventSynchronize(stop);
     float msecTotal = 0.0f;
     cudaEventElapsedTime(&msecTotal, start, stop);
 
-    thrust::device_vector<double>::iterator min = thrust::min_element(path_dists_d.begin(), path_dists_d.end());
-    int min_idx = min - path_dists_d.begin();
-    double min_val = *min;
     //printf("%d\n", min_idx);
     printf("%f 0\n", min_val);
 
-    for (int i=min_idx*N; i<(min_idx+1)*N; i++) {
-        std::cout << all_paths_d[i] << " ";
+    for (int i=0; i<N; i++) {
+        std::cout << best_path[i] << " ";
     }
     printf("\n");
 
@@ -0,0 +1,96 @@
+#include <iostream>
+#include <vector>
+#include <iomanip>
+#include <random>
+#include <string>
+
+// Boost mpi
+#include <boost/mpi.hpp>
+#include <boost/serialization/vector.hpp>
+
+#include "mpi-points.h"
+
+/*
+Transfer microbenchmark for the instance and the solutions: broadcast of the
+points and gather of one tour per rank, once through Boost.Serialization
+(vector<vector<double>>, a tour shipped as its points like loc_sea used to)
+and once as flat arrays (bcast_points, int32 tours through MPI_Gather).
+Prints the mean time of the slowest rank per size.
+How to compile and run:
+mpicxx -O3 -I../common bench-transfer.cpp -lboost_mpi -lboost_serialization
+mpiexec --oversubscribe -n 4 ./a.out 10 100000 1000000
+*/
+
+
+// Mean seconds per call of "fn" on the slowest rank
+template <typename Fn>
+double timed(boost::mpi::communicator &world, int reps, Fn fn) {
+    world.barrier();
+    double start = MPI_Wtime();
+    for (int r=0; r<reps; r++) {
+        fn();
+    }
+    double mine = (MPI_Wtime() - start) / reps, slowest;
+    all_reduce(world, mine, slowest, boost::mpi::maximum<double>());
+    return slowest;
+}
+
+int main(int argc, char *argv[]) {
+    boost::mpi::environment env{argc, argv};
+    boost::mpi::communicator world;
+    int reps = argc > 1 ? std::stoi(argv[1]) : 10;
+    std::vector<int> sizes;
+    for (int i=2; i<argc; i++) {
+        sizes.push_back(std::stoi(argv[i]));
+    }
+    if (sizes.empty()) {
+        sizes = {100000, 300000, 1000000};
+    }
+    if (world.rank() == 0) {
+        std::cout << std::fixed << std::setprecision(3);
+        std::cout << "ranks " << world.size() << ", times in ms" << std::endl;
+        std::cout << "points  bcast-boost  bcast-flat  gather-boost  gather-flat" << std::endl;
+    }
+    for (int N : sizes) {
+        std::mt19937 rng(N);
+        std::uniform_real_distribution<double> coord(0, 1000);
+        std::vector<std::vector<double>> points;
+        if (world.rank() == 0) {
+            for (int i=0; i<N; i++) {
+                points.push_back({coord(rng), coord(rng)});
+            }
+        }
+        auto source = points;
+        double bcast_boost = timed(world, reps, [&] {
+            points = source;
+            broadcast(world, points, 0);
+        });
+        double bcast_flat = timed(world, reps, [&] {
+            points = source;
+            bcast_points(world, points, 0);
+        });
+
+        // Every rank holds a tour of all points
+        std::vector<int> tour(N);
+        for (int i=0; i<N; i++) {
+            tour[i] = (i + world.rank()) % N;
+        }
+        std::vector<std::vector<double>> tour_points;
+        for (int i : tour) {
+            tour_points.push_back({points[i][0], points[i][1], double(i)});
+        }
+        double gather_boost = timed(world, reps, [&] {
+            std::vector<std::vector<std::vector<double>>> all;
+            gather(world, tour_points, all, 0);
+        });
+        double gather_flat = timed(world, reps, [&] {
+            std::vector<int32_t> mine(tour.begin(), tour.end());
+            std::vector<int32_t> all(world.rank() == 0 ? size_t(N) * world.size() : 0);
+            MPI_Gather(mine.data(), N, MPI_INT32_T, all.data(), N, MPI_INT32_T, 0, world);
+        });
+        if (world.rank() == 0) {
+            std::cout << N << "  " << 1e3 * bcast_boost << "  " << 1e3 * bcast_flat << "  " << 1e3 * gather_boost << "  " << 1e3 * gather_flat << std::endl;
+        }
+    }
+    return 0;
+}
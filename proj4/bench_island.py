@@ -0,0 +1,29 @@
+import random
+import subprocess
+import sys
+
+# Tour quality of loc_sea for several rank counts, with and without the island
+# model, under the same time limit. Ranks are oversubscribed so this runs on
+# any machine; on fewer cores than ranks every island gets less CPU time.
+# How to run (from the build directory):
+# python3 ../bench_island.py [cities] [seconds] [repeats]
+
+N = int(sys.argv[1]) if len(sys.argv) > 1 else 200
+seconds = sys.argv[2] if len(sys.argv) > 2 else "5"
+repeats = int(sys.argv[3]) if len(sys.argv) > 3 else 3
+ranks = [1, 2, 4, 8]
+
+random.seed(N)
+instance = "%d\n" % N + "".join("%f %f\n" % (random.random() * 10000, random.random() * 10000) for _ in range(N))
+
+def run(n, args):
+    out = subprocess.run(["mpiexec", "--oversubscribe", "-n", str(n), "./loc_sea", "--time-limit", seconds] + args,
+                         input=instance, capture_output=True, text=True).stdout
+    return float(out.split()[0])
+
+print("cities %d, %s s per run, mean of %d runs" % (N, seconds, repeats))
+print("ranks  restarts  island-ring  island-random")
+for n in ranks:
+    row = [sum(run(n, args) for _ in range(repeats)) / repeats
+           for args in ([], ["--island"], ["--island", "--migrate", "random"])]
+    print("%5d  %8.2f  %11.2f  %13.2f" % (n, row[0], row[1], row[2]))
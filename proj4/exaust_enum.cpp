@@ -8,16 +8,67 @@
 // For writing into file
 #include <fstream>
 #include <string>
+#include <sstream>
+#include <atomic>
+#include <functional>
+#include <omp.h>
 
 // Boost mpi
 #include <boost/mpi.hpp>
 #include <boost/serialization/vector.hpp>
 
+#include "perm-rank.h"
+#include "local-search.h"
+#include "stop-token.h"
+#include "trace.h"
+#include "checkpoint.h"
+#include "branch-bound.h"
+#include "shared-bound.h"
+#include "master-worker.h"
+#include "mpi-best.h"
+#include "mpi-points.h"
+#include "node-matrix.h"
+#include "distributed-steal.h"
+
 
 /*
 How to compile and run:
-clear && mpicxx exaust_enum.cpp -lboost_mpi -lboost_serialization
+clear && mpicxx exaust_enum.cpp -I../common -fopenmp -lboost_mpi -lboost_serialization
 mpiexec --oversubscribe -n 5 ./a.out < inputs/in8
+Every rank splits its work over OMP_NUM_THREADS threads that share one incumbent,
+so one rank per node or socket is enough:
+OMP_NUM_THREADS=8 mpiexec --bind-to socket -x OMP_NUM_THREADS -n 2 ./a.out < inputs/in13
+Ranks on the same node share one distance matrix in an MPI shared memory window,
+its build time and the resident memory per node are printed at the end.
+"--time-limit SEC" stops every rank at the deadline with the best tour so far
+(printed with 0 instead of 1), "--trace FILE" logs every improvement of each
+rank to FILE (rank 0) and FILE.<rank> ("-" for stdout):
+mpiexec --oversubscribe -n 5 ./a.out --time-limit 60 --trace - < inputs/in14
+"--checkpoint FILE" makes every rank save its unfinished ranges (with "--bnb", its
+unfinished depth 3 prefixes) and incumbent to FILE.<rank> every "--checkpoint-every
+SEC" seconds (default 60). "--resume" restarts from those files, also with fewer
+ranks than the run that wrote them. Not supported with "--dynamic" or "--steal":
+mpiexec --oversubscribe -n 5 ./a.out --checkpoint /scratch/enum --resume < inputs/in14
+"--bnb" runs a distributed branch and bound instead (up to 32 cities): ranks split
+the depth 3 prefixes and prune with the best cost of any rank, improvements are
+sent asynchronously and received every "--poll K" nodes (default 1024):
+mpiexec --oversubscribe -n 5 ./a.out --bnb --poll 256 < inputs/in14
+"--dynamic" makes rank 0 a master that hands out work units on request instead
+of splitting the work evenly up front: "--units U" rank ranges of the tours
+(default 1024) or, with "--bnb", the depth 3 prefixes. Workers keep "--prefetch P"
+units queued (default 2). The spread of busy and idle time is printed and
+"--timeline FILE" writes every unit as rank,unit,start,end:
+mpiexec --oversubscribe -n 9 ./a.out --dynamic --timeline units.csv < inputs/in13
+"--steal" (with "--bnb") balances the search tree itself: every rank keeps a deque
+of open paths, expands the newest one and, once out of work, steals the older half
+of a random rank's deque. Paths with at most "--grain G" cities left (default 8)
+are searched in one go. Termination is detected with Safra's token ring; steal
+attempts, success rate, latency and detection time are printed. One thread per rank:
+mpiexec --oversubscribe -n 5 ./a.out --bnb --steal --grain 10 < inputs/in14
+"--deterministic" makes runs without a time limit print the same bytes for any
+number of ranks and threads: tied tours go to the lexicographically smallest
+canonical tour, within a rank and in the final reduction:
+mpiexec --oversubscribe -n 5 ./a.out --bnb --deterministic < inputs/in14
 */
 
 double dist(std::vector<double> p1, std::vector<double> p2) {
@@ -32,39 +83,190 @@ double path_dist(std::vector<int> sol, std::vector<std::vector<double>> points)
     return d;
 }
 
-double backtrack(std::vector<std::vector<double>> points, int idx, double curr_cost, double best_cost, std::vector<int> curr_sol, std::vector<bool> used, std::vector<int> &best_sol, boost::mpi::communicator world) {
-    if (idx == points.size()) {
-        curr_cost += dist(points[curr_sol[0]], points[curr_sol[curr_sol.size()-1]]);
-        if (curr_cost < best_cost) {
-            best_sol = curr_sol;
-            best_cost = curr_cost;
-        }
-        return best_cost;
-    }
-    for (int i=0; i<points.size(); i++) {
-        if (!used[i]) {
-            used[i] = true;
-            curr_sol[idx] = i;
-            double new_cost = curr_cost + dist(points[curr_sol[idx-1]], points[curr_sol[idx]]);
-            if (idx == 1) {
-                if (i % world.size() == world.rank()) {
-                    best_cost = backtrack(points, idx+1, new_cost, best_cost, curr_sol, used, best_sol, world);
-                }
-            }
-            else {
-                best_cost = backtrack(points, idx+1, new_cost, best_cost, curr_sol, used, best_sol, world);
-            }
+// Bound of one rank, shared by its threads. Only the master thread talks
+// MPI (MPI_THREAD_FUNNELED): share() forwards the rank's improvements and
+// folds in the best cost of the other ranks.
+struct RankBound {
+    SharedBound &net;
+    Incumbent &best;
+    long poll;
+    std::atomic<double> remote;
+    // Also run by share() if set, e.g. to answer steal requests
+    std::function<void()> serve = nullptr;
+
+    double cost() const {
+        return std::min(best.cutoff(), best.cutoff(remote.load(std::memory_order_relaxed)));
+    }
 
-            used[i] = false;
-            curr_sol[idx] = -1;
+    void share() {
+        net.improve(best.cost());
+        net.progress();
+        remote.store(net.cost(), std::memory_order_relaxed);
+        if (serve) {
+            serve();
+        }
+    }
+};
+
+// Depth-first B&B below the path sol[0..idx-1], nearest city first. Prunes
+// with the best cost known to any rank; the master thread shares every
+// "poll" nodes.
+void distributed_bnb(BnBData &data, int idx, uint32_t mask, double cost, std::vector<int> &sol, RankBound &bound, long &nodes, StopToken &stop) {
+    int N = data.N;
+    int last = sol[idx-1];
+    if (++nodes % bound.poll == 0 && omp_get_thread_num() == 0) {
+        bound.share();
+    }
+    if (stop.stop_requested()) {
+        return;
+    }
+    if (idx == N) {
+        cost += data.d[last * N];
+        if (cost < bound.cost()) {
+            bound.best.offer(cost, sol);
+        }
+        return;
+    }
+    const int *row = &data.nbr[last * N];
+    for (int k=0; k<N; k++) {
+        int i = row[k];
+        if (mask & (1u << i)) {
+            continue;
+        }
+        double c = cost + data.d[last * N + i];
+        if (lower_bound(data.d, N, i, mask | (1u << i), c) >= bound.cost()) {
+            continue;
         }
+        sol[idx] = i;
+        distributed_bnb(data, idx+1, mask | (1u << i), c, sol, bound, nodes, stop);
+    }
+    sol[idx] = -1;
+}
+
+// Loads FILE.<rank>, FILE.<rank + size>, ... written by the same search on
+// the same instance as "work": their ranges and prefixes are appended to it
+// and the best of their tours is kept. Returns the files read besides the
+// rank's own one.
+std::vector<std::string> load_work(const std::string &path, int rank, int size, Checkpoint &work) {
+    std::vector<std::string> absorbed;
+    for (int k=rank; ; k+=size) {
+        std::string file = path + "." + std::to_string(k);
+        Checkpoint cp;
+        if (!load_checkpoint(file, cp) || cp.N != work.N || cp.engine != work.engine || cp.instance != work.instance) {
+            break;
+        }
+        work.ranges.insert(work.ranges.end(), cp.ranges.begin(), cp.ranges.end());
+        work.prefixes.insert(work.prefixes.end(), cp.prefixes.begin(), cp.prefixes.end());
+        if (cp.best_cost < work.best_cost && cp.best_tour.size() == size_t(work.N)) {
+            work.best_cost = cp.best_cost;
+            work.best_tour = cp.best_tour;
+        }
+        if (k != rank) {
+            absorbed.push_back(file);
+        }
+    }
+    return absorbed;
+}
+
+// Saves the unfinished "work" to FILE.<rank> with the rank's incumbent, which
+// is read last so a tour found in work no longer listed is always in the file
+void save_work(const std::string &path, int rank, Checkpoint &work, Incumbent &best) {
+    auto tour = best.tour();
+    work.best_cost = best.cost();
+    work.best_tour.assign(tour.begin(), tour.end());
+    if (!save_checkpoint(path + "." + std::to_string(rank), work)) {
+        std::cerr << "Could not write checkpoint " << path << "." << rank << std::endl;
     }
-    return best_cost;
 }
 
 int main(int argc, char *argv[]) {
-    boost::mpi::environment env{argc, argv};
+    // Threads share the rank's incumbent, only the master thread calls MPI
+    boost::mpi::environment env{argc, argv, boost::mpi::threading::funneled};
     boost::mpi::communicator world;
+    if (env.thread_level() < boost::mpi::threading::funneled && omp_get_max_threads() > 1) {
+        if (world.rank() == 0) {
+            std::cerr << "MPI does not support threads, running with one thread per rank" << std::endl;
+        }
+        omp_set_num_threads(1);
+    }
+    double time_limit = 0;
+    std::string trace_path;
+    std::string checkpoint_path;
+    double checkpoint_every = 60;
+    bool resume = false;
+    bool bnb = false;
+    long poll = 1024;
+    bool dynamic = false;
+    long units = 1024;
+    int prefetch = 2;
+    std::string timeline_path;
+    bool steal = false;
+    int grain = 8;
+    bool deterministic = false;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--time-limit" && i+1 < argc) {
+            time_limit = std::stod(argv[++i]);
+        }
+        else if (arg == "--trace" && i+1 < argc) {
+            trace_path = argv[++i];
+        }
+        else if (arg == "--checkpoint" && i+1 < argc) {
+            checkpoint_path = argv[++i];
+        }
+        else if (arg == "--checkpoint-every" && i+1 < argc) {
+            checkpoint_every = std::stod(argv[++i]);
+        }
+        else if (arg == "--resume") {
+            resume = true;
+        }
+        else if (arg == "--bnb") {
+            bnb = true;
+        }
+        else if (arg == "--poll" && i+1 < argc) {
+            poll = std::max(1l, std::stol(argv[++i]));
+        }
+        else if (arg == "--dynamic") {
+            dynamic = true;
+        }
+        else if (arg == "--units" && i+1 < argc) {
+            units = std::max(1l, std::stol(argv[++i]));
+        }
+        else if (arg == "--prefetch" && i+1 < argc) {
+            prefetch = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--timeline" && i+1 < argc) {
+            timeline_path = argv[++i];
+        }
+        else if (arg == "--steal") {
+            steal = true;
+        }
+        else if (arg == "--grain" && i+1 < argc) {
+            grain = std::max(1, std::stoi(argv[++i]));
+        }
+        else if (arg == "--deterministic") {
+            deterministic = true;
+        }
+    }
+    steal = steal && bnb && !dynamic;
+    if (steal) {
+        // Open paths move between ranks, one deque per rank
+        omp_set_num_threads(1);
+    }
+    if ((dynamic || steal) && (!checkpoint_path.empty() || resume)) {
+        // Units or paths move between ranks, so no rank knows what is left
+        if (world.rank() == 0) {
+            std::cerr << "--checkpoint and --resume are not supported with --dynamic or --steal" << std::endl;
+        }
+        return 1;
+    }
+    CheckpointTimer timer(checkpoint_every);
+    Trace trace;
+    if (trace_path != "-" && !trace_path.empty() && world.rank() > 0) {
+        trace_path += "." + std::to_string(world.rank());
+    }
+    trace.open(trace_path, "rank " + std::to_string(world.rank()));
+    StopToken stop;
 
     // Setting print decimal precision
     std::cout << std::fixed << std::setprecision(5);
@@ -86,35 +288,425 @@ int main(int argc, char *argv[]) {
     }
     auto start = std::chrono::high_resolution_clock::now();
 
-    broadcast(world, points, 0);
-    broadcast(world, N, 0);
-    std::vector<bool> used(N, false);
-    std::vector<int> curr_sol(N, -1);
+    // Coordinates travel as one flat block, not through Boost.Serialization
+    bcast_points(world, points, 0);
+    N = points.size();
+    if (time_limit > 0) {
+        stop.set_deadline(time_limit);
+    }
+    if (bnb && N > 32) {
+        if (world.rank() == 0) {
+            std::cerr << "--bnb supports at most 32 cities" << std::endl;
+        }
+        return 1;
+    }
+    if (!bnb && N > 21) {
+        // (N-1)!/2 tour ranks no longer fit 64 bits
+        if (world.rank() == 0) {
+            std::cerr << "Enumeration supports at most 21 cities, use --bnb for up to 32" << std::endl;
+        }
+        return 1;
+    }
+    // One matrix per node, shared by its ranks
+    NodeMatrix matrix(world, N, [&](int i, int j) {
+        return dist(points[i], points[j]);
+    });
+    const double *d = matrix.data();
+    // Checkpoints only resume on the instance that wrote them
+    uint64_t instance = instance_fingerprint(d, N);
     std::vector<int> best_sol(N, -1);
-    curr_sol[0] = 0;
-    used[0] = true;
-    double best_cost = backtrack(points, 1, 0, INFINITY, curr_sol, used, best_sol, world);
-    if (world.rank() != 0) {
-        world.send(0, 0, best_sol);
-        world.send(0, 1, best_cost);
+    double best_cost = INFINITY;
+    // Tours found by the threads of this rank
+    Incumbent best(N);
+    best.on_improve([&](double c) {
+        trace.improved(c);
+    });
+    if (deterministic) {
+        best.deterministic([&](const int *tour) {
+            return path_length(d, N, tour);
+        });
     }
-    if (world.rank() == 0) {
-        if (world.size() > 1) {
-            for (int i=1; i<world.size(); i++) {
-                std::vector<int> tmp_sol;
-                double tmp_cost;
-                world.recv(i, 0, tmp_sol);
-                world.recv(i, 1, tmp_cost);
-                if (tmp_cost < best_cost) {
-                    best_cost = tmp_cost;
-                    best_sol = tmp_sol;
+    SharedBound net(world, poll);
+    long nodes = 0;
+    Timeline timeline;
+    DistributedSteal pool(world, world.rank());
+    // A checkpoint of this run before any work is added to it
+    Checkpoint header;
+    header.N = N;
+    header.engine = bnb ? CHECKPOINT_ENUM_BNB : CHECKPOINT_ENUM;
+    header.instance = instance;
+    // Resuming is decided once so ranks without a file of their own stay idle
+    bool resuming = false;
+    if (world.rank() == 0 && resume && !checkpoint_path.empty()) {
+        Checkpoint first;
+        if (load_checkpoint(checkpoint_path + ".0", first)) {
+            resuming = first.N == N && first.engine == header.engine && first.instance == instance;
+            if (!resuming) {
+                std::cerr << "checkpoint " << checkpoint_path << ".0 is from another search or instance, starting over" << std::endl;
+            }
+        }
+    }
+    broadcast(world, resuming, 0);
+    Checkpoint resumed = header;
+    resumed.best_cost = INFINITY;
+    std::vector<std::string> absorbed;
+    if (resuming) {
+        absorbed = load_work(checkpoint_path, world.rank(), world.size(), resumed);
+        if (resumed.best_cost < INFINITY) {
+            best.offer(resumed.best_cost, std::vector<int>(resumed.best_tour.begin(), resumed.best_tour.end()));
+        }
+    }
+    if (N < 3) {
+        if (world.rank() == 0) {
+            for (int i=0; i<N; i++) {
+                best_sol[i] = i;
+            }
+            best_cost = (N == 2) ? 2 * dist(points[0], points[1]) : 0;
+        }
+    }
+    else if (bnb) {
+        // Every rank starts from the same local search tour, only rank 0
+        // keeps it so ties are not reported twice
+        // B&B keeps a private copy, at most 32 x 32 doubles
+        auto data = make_data(std::vector<double>(d, d + N * N), N, false, false);
+        std::vector<int> start_tour = nearest_neighbour(data.d, N);
+        net.seed(descend(data.d, N, start_tour));
+        RankBound bound{net, best, poll, {net.cost()}};
+        if (world.rank() == 0) {
+            rotate_to_zero(start_tour);
+            best.offer(net.cost(), start_tour);
+        }
+        // Unit k is the k-th depth 3 prefix (0, a, b) in lexicographic order,
+        // split by the fourth city into tasks of one parallel region that
+        // spans all the units of the rank. The master keeps about one open
+        // task per thread and searches the rest of the unit itself, so there
+        // is no barrier per unit and it only takes the next one once the
+        // other threads have work
+        std::atomic<int> open(0);
+        std::atomic<long> task_nodes(0);
+        int threads = omp_get_max_threads();
+        auto fourth = [&](int a, int b, int c, uint32_t mask, double cost, long &count) {
+            std::vector<int> sol(N, -1);
+            sol[0] = 0;
+            sol[1] = a;
+            sol[2] = b;
+            sol[3] = c;
+            if (lower_bound(data.d, N, c, mask, cost) < bound.cost()) {
+                distributed_bnb(data, 4, mask, cost, sol, bound, count, stop);
+            }
+        };
+        // Tasks outlive the call of prefix(k), and master_worker only has a
+        // copy of it, so they are spawned from here
+        // "left", if given, counts the parts of the unit still running plus
+        // one until all are handed out. Parts cut short by the deadline never
+        // count down, so the unit stays unfinished in the checkpoint.
+        auto finish = [&](std::atomic<int> *left) {
+            if (left != nullptr && !stop.stop_requested()) {
+                left->fetch_sub(1);
+            }
+        };
+        auto spawn = [&](int a, int b, int c, uint32_t mask, double cost, std::atomic<int> *left) {
+            open.fetch_add(1, std::memory_order_relaxed);
+            if (left != nullptr) {
+                left->fetch_add(1);
+            }
+            #pragma omp task shared(fourth, finish, open, task_nodes)
+            {
+                long count = 0;
+                fourth(a, b, c, mask, cost, count);
+                finish(left);
+                task_nodes.fetch_add(count, std::memory_order_relaxed);
+                open.fetch_sub(1, std::memory_order_relaxed);
+            }
+        };
+        auto cities = [&](long k, int &a, int &b) {
+            a = k / (N - 2) + 1;
+            int j = k % (N - 2) + 1;
+            b = (j < a) ? j : j + 1;
+        };
+        auto prefix = [&](long k, std::atomic<int> *left) {
+            int a, b;
+            cities(k, a, b);
+            uint32_t mask = 1u | (1u << a) | (1u << b);
+            double cost = data.d[a] + data.d[a * N + b];
+            bound.share();
+            if (stop.stop_requested()) {
+                return;
+            }
+            if (lower_bound(data.d, N, b, mask, cost) >= bound.cost()) {
+                finish(left);
+                return;
+            }
+            if (N == 3) {
+                // The prefix is already a tour
+                std::vector<int> sol{0, a, b};
+                distributed_bnb(data, 3, mask, cost, sol, bound, nodes, stop);
+                finish(left);
+                return;
+            }
+            for (int i=0; i<N; i++) {
+                int c = data.nbr[b * N + i];
+                if (mask & (1u << c)) {
+                    continue;
+                }
+                uint32_t next_mask = mask | (1u << c);
+                double next = cost + data.d[b * N + c];
+                if (open.load(std::memory_order_relaxed) >= threads - 1) {
+                    fourth(a, b, c, next_mask, next, nodes);
+                }
+                else {
+                    spawn(a, b, c, next_mask, next, left);
                 }
             }
+            finish(left);
+        };
+        // Steal mode: pushes the children of an open path, or searches it
+        // whole once at most "grain" cities are left
+        auto expand = [&](StealNode &node) {
+            int depth = node.path.size(), last = node.path.back();
+            uint32_t mask = 0;
+            for (int c : node.path) {
+                mask |= 1u << c;
+            }
+            if (++nodes % poll == 0) {
+                bound.share();
+            }
+            if (lower_bound(data.d, N, last, mask, node.cost) >= bound.cost()) {
+                return;
+            }
+            if (N - depth <= grain) {
+                std::vector<int> sol(node.path);
+                sol.resize(N, -1);
+                distributed_bnb(data, depth, mask, node.cost, sol, bound, nodes, stop);
+                return;
+            }
+            // Nearest child last, so it is expanded next
+            for (int k=N-1; k>=0; k--) {
+                int c = data.nbr[last * N + k];
+                double next = node.cost + data.d[last * N + c];
+                if (!(mask & (1u << c)) && lower_bound(data.d, N, c, mask | (1u << c), next) < bound.cost()) {
+                    pool.work.push_back(StealNode{next, node.path});
+                    pool.work.back().path.push_back(c);
+                }
+            }
+        };
+        long prefixes = (N - 1) * (N - 2);
+        if (steal) {
+            // Starts from the round robin deal of the depth 3 prefixes
+            for (long k=world.rank(); k<prefixes; k+=world.size()) {
+                int a, b;
+                cities(k, a, b);
+                pool.work.push_back(StealNode{data.d[a] + data.d[a * N + b], {0, a, b}});
+            }
+            bound.serve = [&] {
+                pool.serve(false);
+            };
+            auto between = [&] {
+                bound.share();
+            };
+            do {
+                while (!pool.work.empty()) {
+                    if (stop.stop_requested()) {
+                        pool.work.clear();
+                        break;
+                    }
+                    StealNode node = std::move(pool.work.back());
+                    pool.work.pop_back();
+                    expand(node);
+                }
+            } while (pool.refill(between));
+            pool.finish(between);
+            bound.serve = nullptr;
         }
+        else {
+            // Units of this rank when they are dealt round robin, or the
+            // prefixes its checkpoint files left
+            std::vector<long> mine;
+            if (resuming) {
+                for (auto &p : resumed.prefixes) {
+                    int j = (p[2] < p[1]) ? p[2] : p[2] - 1;
+                    mine.push_back(long(p[1] - 1) * (N - 2) + j - 1);
+                }
+            }
+            else if (!dynamic) {
+                for (long k=world.rank(); k<prefixes; k+=world.size()) {
+                    mine.push_back(k);
+                }
+            }
+            std::vector<std::atomic<int>> left(mine.size());
+            for (auto &l : left) {
+                l.store(1);
+            }
+            auto save = [&] {
+                Checkpoint work = header;
+                for (size_t i=0; i<mine.size(); i++) {
+                    if (left[i].load() > 0) {
+                        int a, b;
+                        cities(mine[i], a, b);
+                        work.prefixes.push_back({0, a, b});
+                    }
+                }
+                save_work(checkpoint_path, world.rank(), work, best);
+            };
+            if (!checkpoint_path.empty()) {
+                // share() runs on the master thread every "poll" nodes
+                bound.serve = [&] {
+                    if (timer.due()) {
+                        save();
+                        timer.saved();
+                    }
+                };
+            }
+            // Only the master thread drives the units and talks MPI, the
+            // others run its tasks until the end of the region
+            #pragma omp parallel
+            {
+                #pragma omp master
+                {
+                    if (dynamic) {
+                        timeline = master_worker(world, prefixes, prefetch, [&](long k) {
+                            prefix(k, nullptr);
+                        }, [&] {
+                            bound.share();
+                        });
+                    }
+                    else {
+                        for (size_t i=0; i<mine.size(); i++) {
+                            prefix(mine[i], &left[i]);
+                        }
+                    }
+                }
+            }
+            nodes += task_nodes;
+            if (!checkpoint_path.empty()) {
+                bound.serve = nullptr;
+                save();
+                for (auto &file : absorbed) {
+                    std::remove(file.c_str());
+                }
+            }
+        }
+        bound.share();
+        net.finish();
+    }
+    else {
+        if (time_limit > 0 && world.rank() == 0) {
+            seed_anytime(best, d, N);
+        }
+        TourSpace space(N);
+        std::vector<std::pair<uint64_t, uint64_t>> ranges;
+        // Saves ranges[from..]
+        auto save = [&](size_t from) {
+            Checkpoint work = header;
+            work.ranges.assign(ranges.begin() + from, ranges.end());
+            save_work(checkpoint_path, world.rank(), work, best);
+        };
+        // Rounds of one 2^20 tour piece per thread. ranges[k] only advances
+        // past a round once all its pieces are done, so progress can be saved
+        // between rounds
+        auto enumerate = [&](uint64_t &r, uint64_t hi, size_t k) {
+            const uint64_t piece = 1 << 20;
+            while (r < hi && !stop.stop_requested()) {
+                uint64_t round_hi = std::min(hi, r + omp_get_max_threads() * piece);
+                uint64_t done = round_hi;
+                #pragma omp parallel for schedule(dynamic) reduction(min:done)
+                for (uint64_t lo=r; lo<round_hi; lo+=piece) {
+                    double cost = best.cutoff();
+                    std::vector<int> tour;
+                    uint64_t end = enumerate_range(d, N, lo, std::min(round_hi, lo + piece), cost, tour, &stop, deterministic);
+                    if (!tour.empty()) {
+                        best.offer(cost, tour);
+                    }
+                    if (end < std::min(round_hi, lo + piece)) {
+                        done = std::min(done, end);
+                    }
+                }
+                r = done;
+                if (!checkpoint_path.empty() && timer.due()) {
+                    save(k);
+                    timer.saved();
+                }
+            }
+        };
+        if (dynamic) {
+            // Unit k is the k-th of "parts" equal rank ranges
+            long parts = std::min<uint64_t>(units, space.size);
+            timeline = master_worker(world, parts, prefetch, [&](long k) {
+                uint64_t r = range_begin(space.size, parts, k);
+                enumerate(r, range_begin(space.size, parts, k + 1), 0);
+            }, [] {}, true);
+        }
+        else {
+            // Every rank enumerates one contiguous range of the ranked
+            // canonical tours, ranges differ by at most one tour
+            if (resuming) {
+                ranges = resumed.ranges;
+            }
+            else {
+                ranges.push_back({range_begin(space.size, world.size(), world.rank()), range_begin(space.size, world.size(), world.rank() + 1)});
+            }
+            for (size_t k=0; k<ranges.size() && !stop.stop_requested(); k++) {
+                enumerate(ranges[k].first, ranges[k].second, k);
+            }
+        }
+        if (!checkpoint_path.empty()) {
+            ranges.erase(std::remove_if(ranges.begin(), ranges.end(), [](std::pair<uint64_t, uint64_t> &r) {
+                return r.first >= r.second;
+            }), ranges.end());
+            save(0);
+            for (auto &file : absorbed) {
+                std::remove(file.c_str());
+            }
+        }
+    }
+    if (best.cost() < best_cost) {
+        best_cost = best.cost();
+        best_sol = best.tour();
+    }
+    double checkpoint_spent = 0;
+    reduce(world, timer.spent, checkpoint_spent, boost::mpi::maximum<double>(), 0);
+    std::ostringstream memory;
+    matrix.report(world, memory);
+    std::ostringstream balance;
+    if (dynamic) {
+        report_timelines(world, timeline, balance, timeline_path);
+    }
+    long total_nodes = 0, sent = 0, adopted = 0;
+    if (bnb) {
+        reduce(world, nodes, total_nodes, std::plus<long>(), 0);
+        reduce(world, net.sent, sent, std::plus<long>(), 0);
+        reduce(world, net.adopted, adopted, std::plus<long>(), 0);
+    }
+    std::ostringstream stealing;
+    if (steal) {
+        long attempts = 0, successes = 0, moved = 0;
+        double latency = 0, max_latency = 0, detection = 0;
+        reduce(world, pool.attempts, attempts, std::plus<long>(), 0);
+        reduce(world, pool.successes, successes, std::plus<long>(), 0);
+        reduce(world, pool.moved, moved, std::plus<long>(), 0);
+        reduce(world, pool.latency, latency, std::plus<double>(), 0);
+        reduce(world, pool.max_latency, max_latency, boost::mpi::maximum<double>(), 0);
+        // Local clocks only: the rank that ran dry last waited the least
+        reduce(world, pool.done_at - pool.idle_since, detection, boost::mpi::minimum<double>(), 0);
+        stealing << attempts << " steal attempts, " << successes << " successful (" << (attempts ? 100.0 * successes / attempts : 0) << "%), "
+                 << moved << " paths moved, latency " << (attempts ? 1e3 * latency / attempts : 0) << " ms mean, " << 1e3 * max_latency << " ms max, "
+                 << "termination detected " << 1e3 * detection << " ms after the last rank ran dry (" << pool.waves << " token waves)";
+    }
+    int completed = 0;
+    reduce(world, int(!stop.stop_requested()), completed, boost::mpi::minimum<int>(), 0);
+    // One reduction finds the best rank, only its tour is sent
+    if (deterministic) {
+        allreduce_best_ordered(world, N, best_cost, best_sol);
+    }
+    else {
+        allreduce_best(world, N, best_cost, best_sol);
+    }
+    if (world.rank() == 0) {
         auto finish = std::chrono::high_resolution_clock::now();
         auto time_span = (std::chrono::duration_cast<std::chrono::duration<double>>(finish-start)).count();
 
-        std::cout << best_cost << " 1" << std::endl;
+        trace.done(best_cost, completed);
+        std::cout << best_cost << " " << completed << std::endl;
         for (int i=0; i<best_sol.size(); i++) {
             std::cout << best_sol[i];
             if (i < best_sol.size()-1) {
@@ -122,6 +714,19 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        std::cerr << std::endl << memory.str();
+        if (bnb) {
+            std::cerr << std::endl << total_nodes << " nodes, " << sent << " incumbent messages, " << adopted << " lowered the bound";
+        }
+        if (steal) {
+            std::cerr << std::endl << stealing.str();
+        }
+        if (dynamic) {
+            std::cerr << std::endl << balance.str();
+        }
+        if (!checkpoint_path.empty()) {
+            std::cerr << std::endl << "checkpoints took at most " << checkpoint_spent << " s per rank";
+        }
         std::cerr << std::endl << time_span << " s" << std::endl;
         /* Writing results to file */
         std::string test = "ex_enum10";
@@ -19,11 +19,41 @@
 #include <boost/mpi.hpp>
 #include <boost/serialization/vector.hpp>
 
+#include "incumbent.h"
+#include "stop-token.h"
+#include "trace.h"
+#include "mpi-best.h"
+#include "mpi-points.h"
+#include "migration.h"
+#include "local-search.h"
+#include "philox.h"
+
 
 /*
 How to compile and run:
-mpicxx loc_sea.cpp -lboost_mpi -lboost_serialization
+mpicxx loc_sea.cpp -I../common -fopenmp -lboost_mpi -lboost_serialization
 mpiexec --oversubscribe -n 5 ./a.out < inputs/in10
+The restarts of a rank run on OMP_NUM_THREADS threads that share one incumbent,
+so one rank per node or socket is enough:
+OMP_NUM_THREADS=8 mpiexec --bind-to socket -x OMP_NUM_THREADS -n 2 ./a.out < inputs/in10
+"--time-limit SEC" keeps restarting until the deadline instead of doing 10000
+restarts, "--trace FILE" logs every improvement of each rank to FILE
+(rank 0) and FILE.<rank> ("-" for stdout):
+mpiexec --oversubscribe -n 5 ./a.out --time-limit 10 --trace - < inputs/in10
+"--island" runs an island model instead, on one thread per rank: every rank
+evolves "--population P" tours (default 8) with iterated local search for 10000
+generations (or until the time limit) and every "--migrate-every K" generations
+(default 100) sends its best tour to the next rank, or a random one with
+"--migrate random". Migrants replace the worst members. bench_island.py compares
+the tour quality for several rank counts:
+mpiexec --oversubscribe -n 5 ./a.out --island --time-limit 10 < inputs/in15
+Restarts are numbered globally and dealt round robin over the ranks; restart i
+shuffles with its own Philox stream (seed, i), so the same starting tours are
+tried for any number of ranks and threads. Every island has a stream of its own.
+"--seed S" (default 0) picks other streams. With "--deterministic" ties go to
+the lexicographically smallest canonical tour, so runs without "--time-limit"
+and "--island" print the same bytes for any number of ranks and threads:
+mpiexec --oversubscribe -n 5 ./a.out --deterministic < inputs/in10
 */
 
 double dist(std::vector<double> p1, std::vector<double> p2) {
@@ -50,7 +80,7 @@ bool check_intersec(std::vector<double> p1, std::vector<double> p2, std::vector<
 
 
 
-void local_search(std::vector<std::vector<double>> points, double &best_cost, std::vector<std::vector<double>> &best_sol) {
+void local_search(std::vector<std::vector<double>> points, Incumbent &best) {
     bool flag = true;
     while (flag) {
         for (int i=0; i<points.size()-1; i++) {
@@ -81,17 +111,106 @@ void local_search(std::vector<std::vector<double>> points, double &best_cost, st
         }
     }
     auto curr_cost = path_dist(points);
-        if (curr_cost < best_cost) {
-            best_cost = curr_cost;
-            best_sol = points;
+    if (curr_cost < best.cutoff()) {
+        std::vector<int> tour(points.size());
+        for (int i=0; i<points.size(); i++) {
+            tour[i] = int(points[i][2]);
         }
+        best.offer(curr_cost, tour);
+    }
     return;
 }
 
 
+// Population of one island. An offspring replaces the worst member when it
+// is better and no member has the same cost already.
+struct Island {
+    size_t population;
+    std::vector<double> costs;
+    std::vector<std::vector<int>> tours;
+    Incumbent &best;
+
+    bool insert(double cost, const std::vector<int> &tour) {
+        int worst = 0;
+        for (int m=0; m<costs.size(); m++) {
+            if (std::abs(costs[m] - cost) < 1e-9) {
+                return false;
+            }
+            if (costs[m] > costs[worst]) {
+                worst = m;
+            }
+        }
+        if (costs.size() < population) {
+            costs.push_back(cost);
+            tours.push_back(tour);
+        }
+        else if (cost < costs[worst]) {
+            costs[worst] = cost;
+            tours[worst] = tour;
+        }
+        else {
+            return false;
+        }
+        best.offer(cost, tour);
+        return true;
+    }
+
+    int fittest() const {
+        return std::min_element(costs.begin(), costs.end()) - costs.begin();
+    }
+};
+
 int main(int argc, char *argv[]) {
-    boost::mpi::environment env{argc, argv};
+    // Threads share the rank's incumbent, only the master thread calls MPI
+    boost::mpi::environment env{argc, argv, boost::mpi::threading::funneled};
     boost::mpi::communicator world;
+    if (env.thread_level() < boost::mpi::threading::funneled && omp_get_max_threads() > 1) {
+        if (world.rank() == 0) {
+            std::cerr << "MPI does not support threads, running with one thread per rank" << std::endl;
+        }
+        omp_set_num_threads(1);
+    }
+    double time_limit = 0;
+    std::string trace_path;
+    bool island_mode = false;
+    int population = 8;
+    long migrate_every = 100;
+    bool random_neighbour = false;
+    uint64_t seed = 0;
+    bool deterministic = false;
+    for (int i=1; i<argc; i++) {
+        std::string arg = argv[i];
+        if (arg == "--time-limit" && i+1 < argc) {
+            time_limit = std::stod(argv[++i]);
+        }
+        else if (arg == "--trace" && i+1 < argc) {
+            trace_path = argv[++i];
+        }
+        else if (arg == "--island") {
+            island_mode = true;
+        }
+        else if (arg == "--population" && i+1 < argc) {
+            population = std::max(2, std::stoi(argv[++i]));
+        }
+        else if (arg == "--migrate-every" && i+1 < argc) {
+            migrate_every = std::max(1l, std::stol(argv[++i]));
+        }
+        else if (arg == "--migrate" && i+1 < argc) {
+            random_neighbour = std::string(argv[++i]) == "random";
+        }
+        else if (arg == "--seed" && i+1 < argc) {
+            seed = std::stoull(argv[++i]);
+        }
+        else if (arg == "--deterministic") {
+            deterministic = true;
+        }
+    }
+    Trace trace;
+    if (trace_path != "-" && !trace_path.empty() && world.rank() > 0) {
+        trace_path += "." + std::to_string(world.rank());
+    }
+    trace.open(trace_path, "rank " + std::to_string(world.rank()));
+    StopToken stop;
 
     std::vector<std::vector<double>> points, best_sol;
     double best_cost = INFINITY;
@@ -113,43 +232,120 @@ int main(int argc, char *argv[]) {
             temp.push_back(i);
             points.push_back(temp);
         }
-        best_sol = points;
     }
     auto start = std::chrono::high_resolution_clock::now();
-    broadcast(world, points, 0);
-
-    for (int i=0; i<10000; i++) {
-        auto tempvec = points;
-        std::default_random_engine seed(world.rank());
-        // std::default_random_engine seed(std::chrono::system_clock::now().time_since_epoch().count());
-        std::shuffle(tempvec.begin() + 1, tempvec.end(), seed);
-        local_search(tempvec, best_cost, best_sol);
+    // Coordinates travel as one flat block, not through Boost.Serialization
+    bcast_points(world, points, 0);
+    if (time_limit > 0) {
+        stop.set_deadline(time_limit);
     }
 
-    if (world.rank() != 0) {
-        world.send(0, 0, best_sol);
-        world.send(0, 1, best_cost);
+    // Restarts are tasks for the threads of the rank, which share one
+    // incumbent. MPI is only called outside the parallel region.
+    int rank = world.rank(), size = world.size();
+    Incumbent best(points.size());
+    best.on_improve([&](double c) {
+        trace.improved(c);
+    });
+    if (deterministic) {
+        best.deterministic([&](const int *tour) {
+            std::vector<std::vector<double>> path;
+            for (size_t i=0; i<points.size(); i++) {
+                path.push_back(points[tour[i]]);
+            }
+            return path_dist(path);
+        });
     }
-
-    if (world.rank() == 0) {
-        if (world.size() > 1) {
-            for (int i=1; i<world.size(); i++) {
-                std::vector<std::vector<double>> tmp_sol;
-                double tmp_cost;
-                world.recv(i, 0, tmp_sol);
-                world.recv(i, 1, tmp_cost);
-                // std::cout << tmp_cost << std::endl;
-                if (tmp_cost < best_cost) {
-                    best_cost = tmp_cost;
-                    best_sol = tmp_sol;
+    long sent = 0, adopted = 0;
+    if (island_mode) {
+        // Every rank is an island evolving its population with iterated local
+        // search and sending its best tour on every "migrate_every" generations
+        int N = points.size();
+        std::vector<double> d(N * N);
+        for (int i=0; i<N; i++) {
+            for (int j=0; j<N; j++) {
+                d[i * N + j] = dist(points[i], points[j]);
+            }
+        }
+        Philox rng(seed, rank, 1);
+        Migration migration(world, N, random_neighbour, rng());
+        Island island{size_t(population), {}, {}, best};
+        for (int m=0; m<population; m++) {
+            std::vector<int> tour(N);
+            for (int i=0; i<N; i++) {
+                tour[i] = i;
+            }
+            philox_shuffle(tour.begin() + 1, tour.end(), rng);
+            double cost = descend(d, N, tour);
+            rotate_to_zero(tour);
+            island.insert(cost, tour);
+        }
+        for (long g=1; N >= 8 && (time_limit > 0 ? !stop.stop_requested() : g <= 10000); g++) {
+            // The better of two random members is kicked and descended
+            int a = rng.below(island.costs.size()), b = rng.below(island.costs.size());
+            auto child = island.tours[island.costs[a] < island.costs[b] ? a : b];
+            double_bridge(child, rng);
+            double cost = descend(d, N, child);
+            rotate_to_zero(child);
+            island.insert(cost, child);
+            if (g % migrate_every == 0) {
+                int m = island.fittest();
+                migration.emigrate(island.costs[m], island.tours[m]);
+            }
+            // Migrants replace the worst members
+            std::vector<int> tour;
+            while (migration.immigrate(cost, tour)) {
+                adopted += island.insert(cost, tour);
+            }
+        }
+        migration.finish([&](double cost, const std::vector<int> &tour) {
+            adopted += island.insert(cost, tour);
+        });
+        sent = migration.sent;
+    }
+    else {
+        #pragma omp parallel
+        {
+            #pragma omp master
+            {
+                for (long i=rank; time_limit > 0 ? (i == rank || !stop.stop_requested()) : i < 10000; i+=size) {
+                    #pragma omp task firstprivate(i) shared(best, stop)
+                    {
+                        // The first restart always runs so there is a tour to print
+                        if (i == rank || !stop.stop_requested()) {
+                            auto tempvec = points;
+                            Philox rng(seed, i);
+                            philox_shuffle(tempvec.begin() + 1, tempvec.end(), rng);
+                            local_search(tempvec, best);
+                        }
+                    }
                 }
             }
         }
+    }
+    // One reduction finds the best rank, only its tour is sent
+    std::vector<int> best_tour = best.tour();
+    best_cost = best.cost();
+    if (deterministic) {
+        allreduce_best_ordered(world, points.size(), best_cost, best_tour);
+    }
+    else {
+        allreduce_best(world, points.size(), best_cost, best_tour);
+    }
+    long total_sent = 0, total_adopted = 0;
+    reduce(world, sent, total_sent, std::plus<long>(), 0);
+    reduce(world, adopted, total_adopted, std::plus<long>(), 0);
+
+    if (world.rank() == 0) {
+        for (int i : best_tour) {
+            best_sol.push_back(points[i]);
+        }
         auto finish = std::chrono::high_resolution_clock::now();
         auto time_span = (std::chrono::duration_cast<std::chrono::duration<double>>(finish-start)).count();
 
         // Setting print decimal precision
         std::cout << std::fixed << std::setprecision(5);
+        trace.done(path_dist(best_sol), false);
         std::cout << path_dist(best_sol) << " 0" << std::endl;
         for (int i=0; i<best_sol.size(); i++) {
             std::cout << int(best_sol[i][2]);
@@ -158,6 +354,9 @@ int main(int argc, char *argv[]) {
             }
         }
 
+        if (island_mode) {
+            std::cerr << std::endl << total_sent << " migrants sent, " << total_adopted << " adopted";
+        }
         std::cerr << std::endl << time_span << " s" << std::endl;
         /* Writing results to file */
         std::string test = "loc_sea10";